@@ -0,0 +1,66 @@
+// burnercycle.cpp
+
+#include "burnercycle.h"
+
+BurnerCycleManager::BurnerCycleManager(const BurnerCycleParams& params) : params(params) {}
+
+void BurnerCycleManager::flameUpdate(bool flameOn, uint32_t now) {
+  if (!known) {
+    known = true;
+    flame = flameOn;
+    changedAt = now;
+    return;
+  }
+  if (flameOn == flame) return;
+  if (flameOn) {
+    lastOffMs = now - changedAt;
+    startCount++;
+    startTimes[startHead] = now;
+    startHead = (startHead + 1) % BURNER_START_HISTORY;
+  } else {
+    lastOnMs = now - changedAt;
+  }
+  flame = flameOn;
+  changedAt = now;
+}
+
+bool BurnerCycleManager::heatingDemand(float outsideTemp, float threshold) {
+  if (outsideTemp < threshold) demand = true;
+  else if (outsideTemp >= threshold + params.thresholdHysteresis) demand = false;
+  return demand;
+}
+
+bool BurnerCycleManager::holdingOff(uint32_t now) const {
+  // no off time before the first start, the boiler may have been off for hours
+  return known && !flame && startCount > 0 && now - changedAt < params.minOffMs;
+}
+
+float BurnerCycleManager::setpoint(float curveSetpoint, float flowTemp, float returnTemp, uint32_t now) {
+  float minutes = lastSetpointAt ? (now - lastSetpointAt) / 60000.0 : 0.0;
+  lastSetpointAt = now;
+
+  // flow above TSet with a small spread while burning: the radiators take less than the lowest modulation
+  if (flame) {
+    bool overshoot = flowTemp > curveSetpoint - currentShift;
+    if (overshoot && flowTemp - returnTemp < params.minDeltaT) currentShift += params.shiftRate * minutes;
+    else currentShift -= params.shiftRate * minutes;
+    if (currentShift > params.maxShift) currentShift = params.maxShift;
+    if (currentShift < 0) currentShift = 0;
+  }
+  float target = curveSetpoint - currentShift;
+
+  if (holdingOff(now)) return BURNER_HOLD_OFF_SETPOINT;
+  // the boiler stops once the flow overshoots TSet, track the flow until the minimum on time is over
+  if (flame && now - changedAt < params.minOnMs && flowTemp > target) {
+    return flowTemp < curveSetpoint + params.maxShift ? flowTemp : curveSetpoint + params.maxShift;
+  }
+  return target;
+}
+
+uint32_t BurnerCycleManager::startsLastHour(uint32_t now) const {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < BURNER_START_HISTORY && i < startCount; i++) {
+    if (now - startTimes[i] < 3600000UL) n++;
+  }
+  return n;
+}
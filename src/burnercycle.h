@@ -0,0 +1,60 @@
+// burnercycle.h
+
+#ifndef BURNERCYCLE_H
+#define BURNERCYCLE_H
+
+#include <stdint.h>
+
+// Flame starts remembered for the starts per hour figure
+#define BURNER_START_HISTORY 32
+// TSet sent while the minimum off time holds the burner off, below any flow temperature
+#define BURNER_HOLD_OFF_SETPOINT 10.0
+
+struct BurnerCycleParams {
+  uint32_t minOnMs;           // keep a started burner running at least this long
+  uint32_t minOffMs;          // and keep it off this long before the next heating start
+  float thresholdHysteresis;  // heating stays on until outside >= threshold + hysteresis [K]
+  float minDeltaT;            // flow/return spread below which the radiators take less than the burner gives [K]
+  float shiftRate;            // TSet reduction while the spread is too small [K/min]
+  float maxShift;             // [K]
+};
+
+// Keeps the burner from short-cycling in shoulder seasons: tracks flame on/off times from the
+// Status responses, enforces minimum on and off times through TSet and lowers TSet while the
+// flow/return spread shows that the boiler cannot modulate down to the load
+class BurnerCycleManager {
+public:
+  explicit BurnerCycleManager(const BurnerCycleParams& params);
+
+  // Feed the flame bit of every successful Status response
+  void flameUpdate(bool flameOn, uint32_t now);
+  // Heating demand from the outside temperature with hysteresis on the threshold
+  bool heatingDemand(float outsideTemp, float threshold);
+  // TSet to send for a curve setpoint, call about once per second while heating is enabled
+  float setpoint(float curveSetpoint, float flowTemp, float returnTemp, uint32_t now);
+
+  bool flameOn() const { return flame; }
+  bool holdingOff(uint32_t now) const;
+  uint32_t startsLastHour(uint32_t now) const;
+  uint32_t starts() const { return startCount; }
+  float shift() const { return currentShift; }
+  uint32_t lastOnDurationMs() const { return lastOnMs; }
+  uint32_t lastOffDurationMs() const { return lastOffMs; }
+
+  BurnerCycleParams params;
+
+private:
+  bool flame = false;
+  bool known = false;  // flame state seen at least once
+  bool demand = false;
+  uint32_t changedAt = 0;
+  uint32_t lastOnMs = 0;
+  uint32_t lastOffMs = 0;
+  uint32_t startCount = 0;
+  uint32_t startTimes[BURNER_START_HISTORY] = { 0 };
+  uint8_t startHead = 0;
+  float currentShift = 0.0;
+  uint32_t lastSetpointAt = 0;
+};
+
+#endif
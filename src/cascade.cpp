@@ -0,0 +1,159 @@
+// cascade.cpp
+
+#include <math.h>
+#include <string.h>
+#include "cascade.h"
+
+void BoilerCascade::begin(uint8_t count, uint32_t now) {
+  boilers = count < 1 ? 1 : (count > CASCADE_MAX_BOILERS ? CASCADE_MAX_BOILERS : count);
+  for (uint8_t i = 0; i < CASCADE_MAX_BOILERS; i++) {
+    member[i].online = i < boilers;
+    member[i].modulation = 0.0;
+    member[i].enabled = false;
+    member[i].maxModulation = 100.0;
+    member[i].enabledMs = 0;
+  }
+  lead = 0;
+  stages = 0;
+  leadSince = now;
+  stageChangedAt = now;
+  lastUpdate = now;
+}
+
+void BoilerCascade::update(bool demand, uint32_t now) {
+  uint32_t elapsed = now - lastUpdate;
+  lastUpdate = now;
+  uint8_t online = 0;
+  float load = 0.0;  // sum of the running boilers' modulation [%]
+  for (uint8_t i = 0; i < boilers; i++) {
+    CascadeMember& m = member[i];
+    if (m.enabled) m.enabledMs += elapsed;
+    if (!m.online) continue;
+    online++;
+    if (m.enabled) load += m.modulation;
+  }
+
+  // rotation to the boiler with the fewest hours, and a lead that dropped out is replaced right away
+  if (now - leadSince >= CASCADE_ROTATE_MS || !member[lead].online) {
+    uint8_t next = leastUsed();
+    if (next != lead) rotations++;
+    lead = next;
+    leadSince = now;
+  }
+
+  if (!demand || online == 0) {
+    stages = 0;
+  } else {
+    if (stages == 0) {
+      stages = 1;
+      stageChangedAt = now;
+    }
+    if (stages > online) stages = online;
+    bool settled = now - stageChangedAt >= CASCADE_STAGE_DELAY_MS;
+    if (settled && stages < online && load >= stages * CASCADE_STAGE_UP_LEVEL) {
+      stages++;
+      stageChangedAt = now;
+      stageChanges++;
+    } else if (settled && stages > 1 && load < (stages - 1) * CASCADE_STAGE_DOWN_LEVEL) {
+      stages--;
+      stageChangedAt = now;
+      stageChanges++;
+    }
+  }
+
+  // a boiler above its share of the load is capped so the others take over, one below it keeps its
+  // headroom; with all of them at the share the load is spread evenly
+  float share = stages > 0 ? load / stages : 0.0;
+  float cap = share + CASCADE_SHARE_MARGIN;
+  if (cap < CASCADE_MIN_LIMIT) cap = CASCADE_MIN_LIMIT;
+  if (cap > 100.0) cap = 100.0;
+  // the lead and the next online boilers in rotation order
+  uint8_t running = 0;
+  for (uint8_t k = 0; k < boilers; k++) {
+    CascadeMember& m = member[(lead + k) % boilers];
+    bool wasEnabled = m.enabled;
+    m.enabled = m.online && running < stages;
+    if (m.enabled) running++;
+    m.maxModulation = m.enabled && stages > 1 && wasEnabled && m.modulation > share ? cap : 100.0;
+  }
+}
+
+// The online boiler with the least time with demand, the current lead on a tie
+uint8_t BoilerCascade::leastUsed() const {
+  uint8_t best = lead;
+  for (uint8_t k = 1; k <= boilers; k++) {
+    uint8_t i = (lead + k) % boilers;
+    if (!member[i].online) continue;
+    if (!member[best].online || member[i].enabledMs < member[best].enabledMs) best = i;
+  }
+  return best;
+}
+
+BoilerChannel cascadeBoilers[HAL_MAX_EXTRA_BUSES];
+
+// Trampolines of each channel slot for the poll values and the bus response handler
+template <uint8_t N>
+struct ChannelHooks {
+  static uint16_t status() { return otStatusData(cascadeBoilers[N].chEnable, false, false); }
+  // half kelvin steps like the controller's own TSet
+  static uint16_t flowSetpoint() { return otTemperatureToData(roundf(cascadeBoilers[N].flowSetpoint * 2) / 2); }
+  // f8.8 percent
+  static uint16_t maxModulation() { return otTemperatureToData(roundf(cascadeBoilers[N].maxModulation)); }
+  static void response(uint32_t response, OtResponseStatus status, uint32_t ms) {
+    cascadeBoilers[N].onResponse(response, status, ms);
+  }
+};
+static_assert(HAL_MAX_EXTRA_BUSES == 2, "one ChannelHooks instance per slot");
+static const PollValue statusHooks[] = { ChannelHooks<0>::status, ChannelHooks<1>::status };
+static const PollValue setpointHooks[] = { ChannelHooks<0>::flowSetpoint, ChannelHooks<1>::flowSetpoint };
+static const PollValue modulationHooks[] = { ChannelHooks<0>::maxModulation, ChannelHooks<1>::maxModulation };
+static const OtResponseHandler responseHooks[] = { ChannelHooks<0>::response, ChannelHooks<1>::response };
+
+void BoilerChannel::begin(OtBus* bus, uint8_t slot) {
+  this->bus = bus;
+  // central heating only, hot water stays with the controller's own boiler
+  const PollEntry entries[] = {
+    // id, type, priority, interval [ms], fast interval [ms], value
+    { OtId::Status, OT_READ_DATA, 9, 1000, 0, statusHooks[slot] },
+    { OtId::TSet, OT_WRITE_DATA, 8, 10000, 0, setpointHooks[slot] },
+    { OtId::MaxRelModLevelSetting, OT_WRITE_DATA, 7, 60000, 0, modulationHooks[slot] },
+    { OtId::Tboiler, OT_READ_DATA, 5, 10000, 2000, nullptr },
+    { OtId::Tret, OT_READ_DATA, 4, 15000, 5000, nullptr },
+    { OtId::RelModLevel, OT_READ_DATA, 3, 30000, 5000, nullptr },
+  };
+  static_assert(sizeof(entries) == sizeof(table), "channel poll table size");
+  memcpy(table, entries, sizeof(table));
+  poll = OtPollScheduler(table, sizeof(table) / sizeof(table[0]));
+  bus->setResponseHandler(responseHooks[slot]);
+}
+
+void BoilerChannel::query(uint32_t now) {
+  if (bus == nullptr || !bus->isReady()) return;
+  uint8_t index;
+  uint16_t value;
+  if (!poll.next(now, index, value)) return;
+  const PollEntry& entry = poll.entry(index);
+  if (bus->sendRequestAsync(otBuildFrame(entry.type, entry.id, entry.value ? value : 0))) {
+    poll.sent(index, now, value);
+  } else {
+    poll.refused++;
+  }
+}
+
+void BoilerChannel::onResponse(uint32_t response, OtResponseStatus status, uint32_t ms) {
+  poll.responseReceived(status);
+  if (status != OT_SUCCESS) return;
+  lastValidMs = ms;
+  answered = true;
+  uint16_t data = otData(response);
+  switch (otDataId(response)) {
+    case OtId::Status:
+      flame = otIsFlameOn(response);
+      fault = otIsFault(response);
+      poll.setFastMode(flame);
+      break;
+    case OtId::Tboiler: flowTemp = otDataToFloat(data); break;
+    case OtId::Tret: returnTemp = otDataToFloat(data); break;
+    case OtId::RelModLevel: modulation = otDataToFloat(data); break;
+  }
+}
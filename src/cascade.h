@@ -0,0 +1,95 @@
+// cascade.h
+
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "otpoll.h"
+
+// The controller's own boiler plus one on each additional bus (Hal::extraBus)
+#define CASCADE_MAX_BOILERS (1 + HAL_MAX_EXTRA_BUSES)
+// Staging: the next boiler joins when all running ones modulate above the up level for the
+// delay, one leaves when the load would fit into one boiler less at the down level
+#define CASCADE_STAGE_UP_LEVEL 85.0
+#define CASCADE_STAGE_DOWN_LEVEL 40.0
+#define CASCADE_STAGE_DELAY_MS (10UL * 60000)
+// After this time the lead moves to the online boiler with the least time with demand
+#define CASCADE_ROTATE_MS (24UL * 3600000)
+// Modulation limit of a running boiler above its equal share of the load: the share plus the
+// margin, at least the minimum
+#define CASCADE_SHARE_MARGIN 15.0
+#define CASCADE_MIN_LIMIT 30.0
+// A boiler without a valid response for this long is left out
+#define CASCADE_OFFLINE_MS 10000
+
+// What the cascade knows about one boiler and what it decided for it
+struct CascadeMember {
+  bool online;
+  float modulation;     // relative modulation level [%]
+  bool enabled;         // central heating demand for this boiler
+  float maxModulation;  // limit for the boiler [%]
+  uint32_t enabledMs;   // time with demand, the next lead is the boiler with the least
+};
+
+// Lead/lag staging over the boilers: the lead always runs with demand, lag boilers are staged on
+// in rotation order after it. The lead role goes to the boiler with the fewest hours, so the
+// running time evens out. The modulation limits spread the load over the running boilers: one
+// that takes more than its share is capped, the ones below it keep their headroom and take over.
+class BoilerCascade {
+public:
+  void begin(uint8_t count, uint32_t now);
+  // Call periodically with the common heat demand and the members' online state and modulation
+  void update(bool demand, uint32_t now);
+
+  uint8_t count() const { return boilers; }
+
+  CascadeMember member[CASCADE_MAX_BOILERS];
+  uint8_t lead = 0;
+  uint8_t stages = 0;
+  uint32_t stageChanges = 0;
+  uint32_t rotations = 0;
+
+private:
+  uint8_t leastUsed() const;
+
+  uint8_t boilers = 1;
+  uint32_t leadSince = 0;
+  uint32_t stageChangedAt = 0;
+  uint32_t lastUpdate = 0;
+};
+
+// An additional boiler on its own OpenTherm bus with its own poll schedule and readings.
+// The poll values and the response handler are per-slot trampolines, the bus interfaces
+// take plain function pointers.
+class BoilerChannel {
+public:
+  void begin(OtBus* bus, uint8_t slot);
+  // Sends the next due request when the bus is free, call on every pass after bus->process() and drain()
+  void query(uint32_t now);
+  void onResponse(uint32_t response, OtResponseStatus status, uint32_t ms);
+
+  OtBus* bus = nullptr;
+  OtPollScheduler poll = OtPollScheduler(table, 0);
+
+  // commands
+  bool chEnable = false;
+  float flowSetpoint = 0.0;
+  float maxModulation = 100.0;
+
+  // readings
+  float flowTemp = 0.0;
+  float returnTemp = 0.0;
+  float modulation = 0.0;
+  bool flame = false;
+  bool fault = false;
+  uint32_t lastValidMs = 0;
+  bool answered = false;  // a valid response since begin()
+
+private:
+  PollEntry table[6];
+};
+
+extern BoilerChannel cascadeBoilers[HAL_MAX_EXTRA_BUSES];
+
+#endif
@@ -0,0 +1,133 @@
+// configstore.cpp
+
+#include <string.h>
+#include "configstore.h"
+
+// Start of every slot, the crc covers sequence, length, version, reserved and the payload
+struct ConfigHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  uint16_t length;
+  uint8_t version;
+  uint8_t reserved;
+  uint32_t crc;
+};
+static_assert(sizeof(ConfigHeader) == CONFIG_HEADER_BYTES, "config header layout");
+
+uint32_t crc32(const void* data, uint32_t length, uint32_t crc) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (length--) {
+    crc ^= *p++;
+    for (uint8_t i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static uint32_t recordCrc(const ConfigHeader& header, const void* payload) {
+  uint32_t crc = crc32(&header.sequence, 8);
+  return crc32(payload, header.length, crc);
+}
+
+bool ConfigStore::load(Flash& flash, void* data, uint16_t size) {
+  this->flash = &flash;
+  uint32_t slot32[CONFIG_SLOT_BYTES / 4];
+  ConfigHeader* header = (ConfigHeader*)slot32;
+  const uint8_t* payload = (const uint8_t*)slot32 + CONFIG_HEADER_BYTES;
+  bool found = false;
+  uint16_t newestSector = 0;
+  uint8_t newestSlot = 0;
+
+  if (firstSector + sectorCount() > flash.sectorCount()) {
+    this->flash = nullptr;  // range does not fit, nothing is loaded or saved
+    return false;
+  }
+
+  for (uint16_t s = 0; s < sectorCount(); s++) {
+    for (uint8_t i = 0; i < slotsPerSector(); i++) {
+      uint32_t address = (uint32_t)(firstSector + s) * flash.sectorSize() + (uint32_t)i * CONFIG_SLOT_BYTES;
+      if (!flash.read(address, slot32, CONFIG_SLOT_BYTES)) continue;
+      if (header->magic != CONFIG_MAGIC || header->length > CONFIG_MAX_BYTES) continue;
+      if (recordCrc(*header, payload) != header->crc) continue;
+      if (found && (int32_t)(header->sequence - lastSequence) <= 0) continue;
+      found = true;
+      lastSequence = header->sequence;
+      newestSector = s;
+      newestSlot = i;
+      if (header->version == version) {
+        memcpy(data, payload, header->length < size ? header->length : size);
+      }
+    }
+  }
+
+  if (found) {
+    sector = newestSector;
+    slot = newestSlot;
+    advance();
+  } else {
+    sector = 0;
+    slot = 0;
+  }
+  storedCrc = crc32(data, size);
+  liveCrc = storedCrc;
+  return found;
+}
+
+void ConfigStore::advance() {
+  if (++slot >= slotsPerSector()) {
+    slot = 0;
+    sector = (sector + 1) % sectorCount();
+  }
+}
+
+bool ConfigStore::save(const void* data, uint16_t size) {
+  if (flash == nullptr || size > CONFIG_MAX_BYTES) return false;
+  uint32_t slot32[CONFIG_SLOT_BYTES / 4];
+  ConfigHeader* header = (ConfigHeader*)slot32;
+  uint8_t* payload = (uint8_t*)slot32 + CONFIG_HEADER_BYTES;
+  uint16_t bytes = (CONFIG_HEADER_BYTES + size + 3) & ~3;
+
+  header->magic = CONFIG_MAGIC;
+  header->sequence = lastSequence + 1;
+  header->length = size;
+  header->version = version;
+  header->reserved = 0xFF;
+  memset(payload, 0xFF, CONFIG_MAX_BYTES);
+  memcpy(payload, data, size);
+  header->crc = recordCrc(*header, payload);
+
+  // two attempts: a slot that does not read back (not erased, worn) is skipped
+  for (uint8_t attempt = 0; attempt < 2; attempt++) {
+    if (slot == 0) {
+      flash->eraseSector(firstSector + sector);
+      erases++;
+    }
+    uint32_t check[CONFIG_SLOT_BYTES / 4];
+    uint32_t address = slotAddress();
+    advance();
+    if (!flash->write(address, slot32, bytes) || !flash->read(address, check, bytes) || memcmp(check, slot32, bytes) != 0) {
+      failures++;
+      continue;
+    }
+    writes++;
+    lastSequence++;
+    storedCrc = crc32(data, size);
+    return true;
+  }
+  return false;
+}
+
+bool ConfigStore::update(const void* data, uint16_t size, uint32_t now) {
+  uint32_t crc = crc32(data, size);
+  if (crc != liveCrc) {
+    liveCrc = crc;
+    changedAt = now;
+    if (!dirty) firstChangeAt = now;
+    dirty = true;
+  }
+  if (!dirty) return false;
+  if (now - changedAt < CONFIG_DEBOUNCE_MS && now - firstChangeAt < CONFIG_MAX_DELAY_MS) return false;
+  dirty = false;
+  if (crc == storedCrc) return false;  // changed back before it was written
+  return save(data, size);
+}
@@ -0,0 +1,65 @@
+// configstore.h
+
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// Every save goes to the next fixed-size slot, a sector is only erased when the
+// writes move on to it, so the erases are spread round-robin over all sectors
+#define CONFIG_SLOT_BYTES 256
+#define CONFIG_HEADER_BYTES 16
+#define CONFIG_MAX_BYTES (CONFIG_SLOT_BYTES - CONFIG_HEADER_BYTES)
+#define CONFIG_MAGIC 0x43475A48UL  // "HZGC"
+// Quiet time after the last change before it is written, and the longest a change waits
+#define CONFIG_DEBOUNCE_MS 5000
+#define CONFIG_MAX_DELAY_MS 60000
+
+uint32_t crc32(const void* data, uint32_t length, uint32_t crc = 0);
+
+// Versioned, CRC checked configuration blob in flash. Fields may only be appended:
+// a shorter blob of the same version loads its prefix and keeps the defaults for the rest.
+// Each store owns its own range of sectors (sectors = 0: up to the end of the flash).
+class ConfigStore {
+public:
+  ConfigStore(uint8_t version, uint16_t firstSector = 0, uint16_t sectors = 0)
+      : version(version), firstSector(firstSector), sectors(sectors) {}
+
+  // Finds the newest valid record, copies it into data and returns true. data keeps its
+  // defaults if there is none or it has another version.
+  bool load(Flash& flash, void* data, uint16_t size);
+  // Call periodically with the live configuration, writes it once it has been stable for the
+  // debounce time (or changing for the max delay) and differs from what is stored
+  bool update(const void* data, uint16_t size, uint32_t now);
+  // Writes immediately
+  bool save(const void* data, uint16_t size);
+
+  uint32_t sequence() const { return lastSequence; }
+  uint32_t writes = 0;
+  uint32_t erases = 0;
+  uint32_t failures = 0;
+
+private:
+  uint32_t slotAddress() const {
+    return (uint32_t)(firstSector + sector) * flash->sectorSize() + (uint32_t)slot * CONFIG_SLOT_BYTES;
+  }
+  uint8_t slotsPerSector() const { return flash->sectorSize() / CONFIG_SLOT_BYTES; }
+  uint16_t sectorCount() const { return sectors ? sectors : flash->sectorCount() - firstSector; }
+  void advance();
+
+  Flash* flash = nullptr;
+  uint8_t version;
+  uint16_t firstSector;
+  uint16_t sectors;
+  uint16_t sector = 0;  // next slot to write, relative to firstSector
+  uint8_t slot = 0;
+  uint32_t lastSequence = 0;
+  uint32_t storedCrc = 0;  // of the payload in flash
+  uint32_t liveCrc = 0;    // of the payload seen by the last update()
+  bool dirty = false;
+  uint32_t changedAt = 0;
+  uint32_t firstChangeAt = 0;
+};
+
+#endif
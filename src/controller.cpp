@@ -0,0 +1,757 @@
+// controller.cpp
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "controller.h"
+#include "otdispatch.h"
+
+// Payload: number of hours to return, empty for everything
+#define HISTORY_REQUEST_TOPIC "hzg/history/get"
+#define HISTORY_TOPIC "hzg/history"
+// Payload: "<utc of the first value>,<t0>,<t1>,..." hourly outside temperatures
+#define FORECAST_TOPIC "hzg/forecast"
+// Payload: room temperature in °C, e.g. from a Home Assistant automation
+#define ROOM_TEMP_TOPIC "hzg/room/temperature"
+// Payload: {"ch":[[<day>,"HH:MM",<room °C>],...],"dhw":[...]}, see parseWeekSchedule(), empty for the day periods
+#define SCHEDULE_TOPIC "hzg/schedule/set"
+// Any payload: the trace ring is published once to TRACE_TOPIC, see OtTrace::exportTo()
+#define TRACE_REQUEST_TOPIC "hzg/trace/get"
+#define TRACE_TOPIC "hzg/trace"
+// Back to the plain curve when no room temperature arrived for this long
+#define ROOM_TEMP_STALE_MS (30UL * 60000)
+// Minutes of history the outside temperature trend is fitted over
+#define TREND_MINUTES 180
+// Curve shift per kelvin the scheduled room setpoint is off the "Raum Soll" the curve is tuned for
+#define ROOM_SETPOINT_FLOW_GAIN 3.0
+
+Hal hal = { nullptr, nullptr, nullptr, nullptr, nullptr, { nullptr, nullptr }, nullptr };
+
+HeatingMode heatingMode = OTemp_AUTO;
+
+HotWaterMode hotWaterMode = AUTOMATIC;
+
+TimeOfDay timeOfDay = EVENING;
+float daytime = 0.0;
+float morningStart = 6.0;
+float dayStart = 10.0;
+float afternoonStart = 16.0;
+float nightStart = 21.0;
+bool scheduleChanged = false;  // day period boundaries changed, re-evaluate before the next minute
+OptimalStart optimalStart;
+
+WeekSchedule schedule[SCHEDULE_CIRCUITS];
+WeekSchedule customSchedule[SCHEDULE_CIRCUITS];
+int8_t preheatPoint[SCHEDULE_CIRCUITS] = { -1, -1 };
+float scheduledRoomSP = 20.5;
+float scheduledDhwSP = 46.0;
+
+// Day of the week and Legionella program day
+int dayOfWeek = 1;
+int legionellaProgramDay = 0;
+
+// Flags for enabling various functions
+bool enableHeatingProgram = true;
+bool enableHotWaterProgram = true;
+bool enableLegionellaProgram = true;
+
+bool enableCentralHeating = false;
+bool enableHotWater = false;
+bool enableCooling = false;
+
+// Flags indicating current system states
+bool isEnabledCentralHeating = false;
+bool isEnabledHotWater = false;
+bool isEnabledFlame = false;
+
+// Temperature thresholds
+float heatingThreshold = 17.0;
+float boilerTempSP = 0.0;
+float boilerTempBoost = 55.0;
+
+float dhwTemp = 0.0;
+// Hot water temperature setpoints
+float dhwTempSP = 0.0;
+float dhwTempNightSP = 20.0;
+float dhwTempMorningSP = 40.0;
+float dhwTempEveningSP = 46.0;
+float dhwTempDaySP = 35.0;
+float dhwLegionellenSP = 70.0; //the actual temperature is higher anyway
+float dhwTempBoostSP = 50.0;
+float dhwHysteresis = 5.0;
+// 12 l/min through the tank coil
+DhwChargeManager dhwCharge({ 5.0, 12.0 / 60 * 4186, 10000 });
+
+// Flags for forcing specific temperatures
+bool dhwForceTemp = false;
+bool heatForceTemp = false;
+
+// Temperature readings
+float outsideTemp = -4.0;
+float returnWaterTemp = 0.0;
+float boilerTemp = 0.0;
+float flowRate = 0.0;
+float exhaustTemp = 0.0;
+
+// Boiler diagnostics
+float relModLevel = 0.0;
+float chPressure = 0.0;
+bool isFault = false;
+uint8_t faultFlags = 0;
+uint8_t oemFaultCode = 0;
+float burnerStarts = 0.0;
+float burnerOperationHours = 0.0;
+
+// Temperature adjustment factors
+float nightOffsetFactor = 1.0;  // No Night Offset
+float tempShiftValue = -1.5;
+
+// Temperature control parameters, see rebuildHeatingCurve()
+CurveShape curveShape = CURVE_CUBIC;
+float steepness = -0.5;
+float zeroSetpoint = 36.0;
+float curvature = 0.0005;
+HeatingCurve heatingCurve;
+
+float buildingTimeConstant = 0.0;  // [h], 0 = predictive curve off
+float predictedOutsideTemp = 0.0;
+OutsidePredictor outsidePredictor;
+
+float roomTemp = 0.0;
+float roomSetpoint = 20.5;
+bool roomTempReceived = false;
+uint32_t roomTempAt = 0;
+uint32_t roomPidAt = 0;
+// 4 K flow per K room error, integral time 2 h, trim limited to +-10 K
+PidController roomPid(4.0, 4.0 / 7200, 0.0, -10.0, 10.0);
+
+// Anti short-cycling: 3 min on, 20 min off, 1 K threshold hysteresis, TSet lowered by
+// 0.2 K/min (up to 5 K) while the flow overshoots with less than 3 K flow/return spread
+BurnerCycleManager burnerCycle({ 180000, 1200000, 1.0, 3.0, 0.2, 5.0 });
+
+BoilerCascade cascade;
+bool heatingDemand = false;
+float cascadeFlowSP = 0.0;
+// last valid response of the own boiler, its online state in the cascade like the extra buses
+uint32_t ownBoilerValidMs = 0;
+bool ownBoilerAnswered = false;
+
+// Display-related variables
+FixedString<LCD_STATE_WIDTH> state = "Error";
+unsigned int data = 0xFFFF;
+FixedString<4> wifiRSSI = " NC";
+FixedString<5> timeString;
+LcdFrame frame;  // shadow framebuffer, see showMain()
+
+TelemetryHistory history;
+ConfigStore configStore(CONFIG_VERSION, 0, CONFIG_SECTORS);
+ConfigStore scheduleStore(SCHEDULE_VERSION, CONFIG_SECTORS, CONFIG_SECTORS);
+static_assert(sizeof(customSchedule) <= CONFIG_MAX_BYTES, "schedule blob too large for a config slot");
+uint8_t historyRequestBlocks = 0;  // pending MQTT history request
+OtGateway otGateway;
+OtTrace otTrace;
+BootTimes bootTimes;
+uint32_t otLastRequest = 0;  // own request in flight, for the trace
+bool traceRequested = false;
+
+void rebuildHeatingCurve() {
+  HeatingCurveParams params = { curveShape, steepness, zeroSetpoint, curvature, tempShiftValue };
+  heatingCurve.build(params);
+}
+
+// Data words of the change driven requests
+uint16_t statusData() {
+  return otStatusData(enableCentralHeating, enableHotWater, enableCooling);
+}
+
+uint16_t boilerTempSPData() {
+  // the curve moves continuously, half kelvin steps keep TSet writes change driven
+  return otTemperatureToData(round(boilerTempSP * 2) / 2);
+}
+
+uint16_t dhwTempSPData() {
+  return otTemperatureToData(dhwTempSP);
+}
+
+uint16_t maxModulationData() {
+  return otTemperatureToData(roundf(cascade.member[0].maxModulation));  // f8.8 percent
+}
+
+// OpenTherm poll schedule: setpoints and status are sent when they change or their keep-alive runs out,
+// readings are refreshed at their own interval (fast interval while the burner is on)
+PollEntry pollTable[] = {
+  // id, type, priority, interval [ms], fast interval [ms], value
+  { OtId::Status, OT_READ_DATA, 9, 1000, 0, statusData },  // master must talk at least once per second
+  { OtId::TSet, OT_WRITE_DATA, 8, 10000, 0, boilerTempSPData },
+  { OtId::TdhwSet, OT_WRITE_DATA, 7, 30000, 0, dhwTempSPData },
+  { OtId::MaxRelModLevelSetting, OT_WRITE_DATA, 6, 60000, 0, maxModulationData },  // share of a cascade
+  { OtId::Tboiler, OT_READ_DATA, 5, 10000, 2000, nullptr },
+  { OtId::Tret, OT_READ_DATA, 4, 15000, 5000, nullptr },
+  { OtId::Tdhw, OT_READ_DATA, 4, 15000, 5000, nullptr },
+  { OtId::Texhaust, OT_READ_DATA, 2, 30000, 10000, nullptr },
+  { OtId::Toutside, OT_READ_DATA, 1, 30000, 0, nullptr },
+  { OtId::RelModLevel, OT_READ_DATA, 3, 30000, 5000, nullptr },
+  { OtId::DHWFlowRate, OT_READ_DATA, 2, 30000, 5000, nullptr },
+  { OtId::ASFflags, OT_READ_DATA, 2, 30000, 0, nullptr },
+  { OtId::CHPressure, OT_READ_DATA, 1, 60000, 0, nullptr },
+  { OtId::BurnerStarts, OT_READ_DATA, 0, 300000, 0, nullptr },
+  { OtId::BurnerOperationHours, OT_READ_DATA, 0, 600000, 0, nullptr },
+};
+OtPollScheduler otPoll(pollTable, sizeof(pollTable) / sizeof(pollTable[0]));
+
+// Status carries the flags of both sides, timeouts and invalid frames are reported here as well.
+// The burner and DHW timing use the capture time, not the time the decoder got to the frame.
+void onStatusResponse(uint32_t response, OtResponseStatus status, uint32_t ms) {
+  if (status == OT_SUCCESS) {
+    isEnabledCentralHeating = otIsCentralHeatingActive(response);
+    isEnabledHotWater = otIsHotWaterActive(response);
+    isEnabledFlame = otIsFlameOn(response);
+    isFault = otIsFault(response);
+    otPoll.setFastMode(isEnabledFlame);  // temperatures move quickly while the burner is on
+    burnerCycle.flameUpdate(isEnabledFlame, ms);
+    dhwCharge.boilerUpdate(isEnabledHotWater, isEnabledFlame, boilerTemp, returnWaterTemp, ms);
+    char text[LCD_STATE_WIDTH + 1];
+    formatBoilerState(text, sizeof(text), isEnabledFlame, isFault, oemFaultCode);
+    state = text;
+  }
+  if (status == OT_NONE) {
+    halLog("Error: OpenTherm is not initialized");
+    state = "no Init ";
+  } else if (status == OT_INVALID) {
+    FixedString<32> message = "Error: Invalid response ";
+    halLog(message.appendHex(response).c_str());
+    state.clear().appendHex(response, 8);
+  } else if (status == OT_TIMEOUT) {
+    halLog("Error: Response timeout");
+    state = "Timeout ";
+  }
+}
+
+// Application-specific fault flags in the high byte, OEM fault code in the low byte
+void onFaultResponse(uint32_t response, OtResponseStatus status, uint32_t) {
+  if (status != OT_SUCCESS) return;
+  faultFlags = otData(response) >> 8;
+  oemFaultCode = otData(response) & 0xFF;
+}
+
+// Response registry: decoder, destination and filter per data ID
+constexpr OtReading otReadings[] = {
+  // id, decoder, destination, filter, filter parameter, handler
+  { OtId::Status, OT_FLAG8_LB, nullptr, OT_FILTER_NONE, 0, onStatusResponse },
+  { OtId::Toutside, OT_F88, &outsideTemp, OT_FILTER_EMA, 0.1, nullptr },  // sensor in the sun, slow
+  { OtId::Tboiler, OT_F88, &boilerTemp, OT_FILTER_NONE, 0, nullptr },     // control input, unfiltered
+  { OtId::Tret, OT_F88, &returnWaterTemp, OT_FILTER_NONE, 0, nullptr },
+  { OtId::Tdhw, OT_F88, &dhwTemp, OT_FILTER_MEDIAN3, 0, nullptr },        // spikes while tapping
+  { OtId::Texhaust, OT_F88, &exhaustTemp, OT_FILTER_MEDIAN3, 0, nullptr },
+  { OtId::RelModLevel, OT_F88, &relModLevel, OT_FILTER_NONE, 0, nullptr },
+  { OtId::DHWFlowRate, OT_F88, &flowRate, OT_FILTER_NONE, 0, nullptr },
+  { OtId::ASFflags, OT_FLAG8_HB, nullptr, OT_FILTER_NONE, 0, onFaultResponse },
+  { OtId::CHPressure, OT_F88, &chPressure, OT_FILTER_MEDIAN3, 0, nullptr },
+  { OtId::BurnerStarts, OT_U16, &burnerStarts, OT_FILTER_NONE, 0, nullptr },
+  { OtId::BurnerOperationHours, OT_U16, &burnerOperationHours, OT_FILTER_NONE, 0, nullptr },
+};
+constexpr OtReadingTable<sizeof(otReadings) / sizeof(otReadings[0])> otReadingTable(otReadings);
+OtFilterState otFilterState[otReadingTable.size()];
+
+void decodeResponse(uint32_t response, OtResponseStatus status, uint32_t ms) {
+  if (status == OT_SUCCESS) {
+    bootTimes.mark(BOOT_OT_RESPONSE, ms);
+    ownBoilerValidMs = ms;
+    ownBoilerAnswered = true;
+  }
+  int16_t index = otReadingTable.find(otDataId(response));
+  if (index < 0) return;
+  otDispatch(otReadingTable.reading(index), otFilterState[index], response, status, ms);
+}
+
+void processResponse(uint32_t response, OtResponseStatus status, uint32_t ms) {
+  //Set water temp or set boiler temp need to be send successfuly, the poll schedule repeats unacknowledged writes
+  otPoll.responseReceived(status);
+  otTrace.record(otLastRequest, response, status, OT_TRACE_CONTROLLER, false, ms);
+  decodeResponse(response, status, ms);
+}
+
+// Gateway mode: the boiler's answer goes back to the thermostat, the readings are decoded on the way
+void gatewayResponse(uint32_t response, OtResponseStatus status, uint32_t ms) {
+  if (otGateway.onBoilerResponse(response, status, hal.clock->millis())) {
+    bool overridden = otGateway.forwardedRequest() != otGateway.originalRequest();
+    otTrace.record(otGateway.forwardedRequest(), response, status, OT_TRACE_THERMOSTAT, overridden, ms);
+  }
+  decodeResponse(response, status, ms);
+}
+
+// The controller's setpoints replace the thermostat's while its programs are on
+uint32_t gatewayOverride(uint32_t request) {
+  if (otMessageType(request) != OT_WRITE_DATA) return request;
+  uint8_t id = otDataId(request);
+  if (id == OtId::TSet && enableHeatingProgram) return otBuildFrame(OT_WRITE_DATA, id, boilerTempSPData());
+  if (id == OtId::TdhwSet && enableHotWaterProgram) return otBuildFrame(OT_WRITE_DATA, id, dhwTempSPData());
+  return request;
+}
+
+void forwardThermostat() {
+  otGateway.forward(hal.clock->millis());
+}
+
+void queryDataFromTherme() {
+  //Communicate OPENTHERM
+  if (!hal.bus->isReady()) return;
+  uint8_t index;
+  uint16_t value;
+  uint32_t now = hal.clock->millis();
+  if (!otPoll.next(now, index, value)) return;  // nothing due, leave the bus idle
+
+  const PollEntry& entry = otPoll.entry(index);
+  uint16_t payload = entry.value ? value : data;
+  uint32_t aReq = otBuildFrame(entry.type, entry.id, payload);
+  if (hal.bus->sendRequestAsync(aReq)) {
+    otLastRequest = aReq;
+    otPoll.sent(index, now, value);
+  } else {
+    otPoll.refused++;
+  }
+}
+
+
+// Formats " 7:05" / "17:05"
+void getTimeString(FixedString<5>& out) {
+  out.clear().appendInt(timeService.hour(), 2).append(':').appendInt(timeService.minute(), 2, '0');
+}
+
+bool isRoomTempFresh() {
+  return roomTempReceived && hal.clock->millis() - roomTempAt < ROOM_TEMP_STALE_MS;
+}
+
+// Flow temperature correction from the room temperature, 0 without a fresh one
+// Whenever the trim is not applied, so the next call neither integrates the pause as one step
+// nor starts from an integral that was built up under other conditions
+void resetRoomTrim() {
+  roomPid.reset();
+  roomPidAt = 0;
+}
+
+float roomTrim() {
+  uint32_t now = hal.clock->millis();
+  if (!isRoomTempFresh()) {
+    resetRoomTrim();
+    return 0.0;
+  }
+  float dt = roomPidAt ? (now - roomPidAt) / 1000.0 : 0.0;
+  roomPidAt = now;
+  return roomPid.update(scheduledRoomSP, roomTemp, dt);
+}
+
+void manageHeating() {
+  enableCentralHeating = false;
+  bool trimmed = false;
+  if (enableHeatingProgram){
+    if (heatingMode == OTemp_AUTO) {
+      uint32_t utc = timeService.isSynced() ? timeService.utc() : 0;
+      predictedOutsideTemp = outsidePredictor.effective(outsideTemp, utc, buildingTimeConstant);
+      heatingDemand = burnerCycle.heatingDemand(predictedOutsideTemp, heatingThreshold);
+      // in a cascade this boiler only heats while it is staged on
+      enableCentralHeating = heatingDemand && (cascade.count() == 1 || cascade.member[0].enabled);
+      //curve table, interpolated: -0.5x - 0.0005x^3 + 36 with the default parameters
+      boilerTempSP = heatingCurve.setpoint(predictedOutsideTemp);
+      if (timeOfDay == 0) boilerTempSP = boilerTempSP * nightOffsetFactor;
+      boilerTempSP += (scheduledRoomSP - roomSetpoint) * ROOM_SETPOINT_FLOW_GAIN;
+      if (heatingDemand) {
+        boilerTempSP += roomTrim();
+        trimmed = true;
+      }
+      cascadeFlowSP = boilerTempSP;
+      if (enableCentralHeating) {
+        boilerTempSP = burnerCycle.setpoint(boilerTempSP, boilerTemp, returnWaterTemp, hal.clock->millis());
+      }
+      // heat-ups are only measurable with a room temperature
+      bool measurable = enableCentralHeating && isRoomTempFresh();
+      optimalStart.track(OPTSTART_HEATING, hal.clock->millis(), outsideTemp, roomTemp, measurable ? scheduledRoomSP : 0);
+      //if (boilerTempSP<31 && boilerTempSP >27) boilerTempSP = 31; //Disable boiler pwm
+      //if (boilerTempSP<31 && boilerTempSP <=27) boilerTempSP = 24; //Disable boiler pwm
+    } else if (heatingMode == BOOST) {
+      heatingDemand = true;
+      enableCentralHeating = cascade.count() == 1 || cascade.member[0].enabled;
+      boilerTempSP = boilerTempBoost;
+      cascadeFlowSP = boilerTempBoost;
+    }
+  }
+  if (!enableHeatingProgram) heatingDemand = false;
+  if (!trimmed) resetRoomTrim();
+}
+
+// Stages the boilers of a cascade and hands the common setpoint to the other buses
+void updateCascade() {
+  uint32_t now = hal.clock->millis();
+  cascade.member[0].online = ownBoilerAnswered && now - ownBoilerValidMs < CASCADE_OFFLINE_MS;
+  cascade.member[0].modulation = relModLevel;
+  for (uint8_t i = 1; i < cascade.count(); i++) {
+    BoilerChannel& ch = cascadeBoilers[i - 1];
+    cascade.member[i].online = ch.answered && now - ch.lastValidMs < CASCADE_OFFLINE_MS;
+    cascade.member[i].modulation = ch.modulation;
+  }
+  cascade.update(heatingDemand, now);
+  for (uint8_t i = 1; i < cascade.count(); i++) {
+    BoilerChannel& ch = cascadeBoilers[i - 1];
+    ch.chEnable = cascade.member[i].enabled;
+    ch.flowSetpoint = cascadeFlowSP;
+    ch.maxModulation = cascade.member[i].maxModulation;
+  }
+}
+
+// The extra buses share one task, each runs its own state machine and poll schedule
+void serviceCascadeBuses() {
+  uint32_t now = hal.clock->millis();
+  for (uint8_t i = 1; i < cascade.count(); i++) {
+    cascadeBoilers[i - 1].bus->process();
+    cascadeBoilers[i - 1].bus->drain(OT_DECODE_BATCH);
+    cascadeBoilers[i - 1].query(now);
+  }
+}
+float dhwSetpointFor(TimeOfDay period) {
+  if (period == MORNING) return dhwTempMorningSP;
+  if (period == DAY) return dhwTempDaySP;
+  if (period == EVENING) return dhwTempEveningSP;
+  return dhwTempNightSP;
+}
+
+void manageHotWater() {
+  float setpoint = 0.0;  // no hot water
+  bool forced = false;   // boost and Legionella start a charge right away
+
+  if (enableHotWaterProgram && hotWaterMode == AUTOMATIC) {
+    setpoint = scheduledDhwSP;
+  }
+  else if (enableHotWaterProgram && hotWaterMode == MANUAL) {
+    setpoint = dhwTempBoostSP;
+    forced = true;
+  }
+  
+  if (enableLegionellaProgram && dayOfWeek == legionellaProgramDay && timeOfDay==EVENING) {
+    setpoint = dhwLegionellenSP;
+    forced = true;
+  }
+  if (setpoint > 0) dhwTempSP = setpoint;
+
+  // between charges the boiler does not keep the tank at TdhwSet on its own
+  dhwCharge.params.hysteresis = dhwHysteresis;
+  enableHotWater = dhwCharge.update(dhwTemp, setpoint, forced, hal.clock->millis());
+
+  // learn how long the tank takes, whatever raised the setpoint
+  optimalStart.track(OPTSTART_DHW, hal.clock->millis(), outsideTemp, dhwTemp, enableHotWater ? dhwTempSP : 0);
+}
+
+// Default schedule of a circuit: the four day periods, every day of the week
+static void buildPeriodSchedule(ScheduleCircuit circuit, WeekSchedule& out) {
+  const float starts[4] = { morningStart, dayStart, afternoonStart, nightStart };
+  const TimeOfDay periods[4] = { MORNING, DAY, EVENING, NIGHT };
+  out.clear();
+  for (uint8_t i = 0; i < 4; i++) {
+    float setpoint = circuit == SCHEDULE_DHW ? dhwSetpointFor(periods[i]) : roomSetpoint;
+    out.add(SCHEDULE_EVERY_DAY, (uint16_t)(starts[i] * 60) % 1440, setpoint);
+  }
+}
+
+void rebuildSchedule() {
+  for (uint8_t c = 0; c < SCHEDULE_CIRCUITS; c++) {
+    if (customSchedule[c].count > 0) schedule[c] = customSchedule[c];
+    else buildPeriodSchedule((ScheduleCircuit)c, schedule[c]);
+    preheatPoint[c] = -1;  // indices changed
+  }
+}
+
+// Setpoint of a circuit at this minute of the week. Optimal start: the next point is taken early when
+// the learned heat-up from value would not be done by its start, and stays until its regular start.
+static float scheduledSetpoint(ScheduleCircuit circuit, uint16_t minuteOfWeek, bool preheat, OptimalStartKind kind,
+                               float value) {
+  const WeekSchedule& s = schedule[circuit];
+  int8_t& early = preheatPoint[circuit];
+  int8_t index = s.indexAt(minuteOfWeek);
+  if (early == index) early = -1;
+  if (early < 0 && preheat && s.count > 1) {
+    uint8_t next = s.next(index);
+    if (s.minutesUntil(minuteOfWeek, next) <= optimalStart.leadMinutes(kind, outsideTemp, value, s.setpoint(next))) {
+      early = next;
+    }
+  }
+  return s.setpoint(early >= 0 ? early : index);
+}
+
+void manageDayAndTime() {
+  bool newMinute = timeService.update(hal.clock->millis());
+  if (timeService.isSynced()) {
+    if (!newMinute && !scheduleChanged) return;
+    if (scheduleChanged) rebuildSchedule();
+    scheduleChanged = false;
+    dayOfWeek = timeService.dayOfWeek();
+    dhwCharge.dayChange(dayOfWeek);
+    getTimeString(timeString);
+    float hours = timeService.minuteOfDayValue() / 60.0;
+    timeOfDay = NIGHT;
+    if (hours >= morningStart) timeOfDay = MORNING;
+    if (hours >= dayStart) timeOfDay = DAY;
+    if (hours >= afternoonStart) timeOfDay = EVENING;
+    if (hours >= nightStart) timeOfDay = NIGHT;
+
+
+    uint16_t minuteOfWeek = dayOfWeek * 1440 + timeService.minuteOfDayValue();
+    scheduledDhwSP = scheduledSetpoint(SCHEDULE_DHW, minuteOfWeek, enableHotWaterProgram && hotWaterMode == AUTOMATIC,
+                                       OPTSTART_DHW, dhwTemp);
+    scheduledRoomSP = scheduledSetpoint(SCHEDULE_CH, minuteOfWeek, enableHeatingProgram && isRoomTempFresh(),
+                                        OPTSTART_HEATING, roomTemp);
+  }
+  //usefull defaults if no time is available
+  else{
+    dayOfWeek = 1;
+    timeOfDay = EVENING;
+    scheduledDhwSP = dhwTempEveningSP;
+    scheduledRoomSP = roomSetpoint;
+    heatingMode = OTemp_AUTO;
+    hotWaterMode = AUTOMATIC;
+  }
+
+}
+
+void showMain() {
+  FixedString<15> ipStr = "not connected";
+  wifiRSSI = " NC";
+  if (hal.mqtt->isNetworkConnected()) {
+    uint8_t ip[4];
+    hal.mqtt->localIp(ip);
+    ipStr.clear().appendInt(ip[0]).append('.').appendInt(ip[1]).append('.').appendInt(ip[2]).append('.').appendInt(ip[3]);
+    wifiRSSI.clear().appendInt(hal.mqtt->rssi(), 3);
+  }
+  //1st row
+  frame.print(0, 0, ipStr.c_str(), 17);
+  frame.print(17, 0, wifiRSSI.c_str(), 3);
+
+  //2nd row
+  frame.print(0, 1, state.c_str(), LCD_STATE_WIDTH);
+  frame.print(8, 1, isEnabledCentralHeating ? "CH On" : "", 6);
+  frame.print(14, 1, isEnabledHotWater ? "HW On" : "", 6);
+
+  //3rd row - col, row
+  frame.print(0, 2, "SP");
+  frame.printNumber(2, 2, boilerTempSP, 3);
+  frame.print(5, 2, "BO");
+  frame.printNumber(7, 2, boilerTemp, 3);
+  frame.print(10, 2, "RW");
+  frame.printNumber(12, 2, returnWaterTemp, 3);
+  frame.print(15, 2, "EX");
+  frame.printNumber(17, 2, exhaustTemp, 3);
+
+  //4th row
+  frame.print(0, 3, "SP");
+  frame.printNumber(2, 3, dhwTempSP, 3);
+  frame.print(5, 3, "WT");
+  frame.printNumber(7, 3, dhwTemp, 3);
+  frame.print(10, 3, "OT");
+  frame.printNumber(12, 3, outsideTemp, 3);
+  frame.print(15, 3, timeString.c_str(), 5);
+
+  // only the changed cells go over I2C
+  frame.flush(*hal.display);
+}
+
+void recordHistory() {
+  float values[HISTORY_CHANNELS];
+  values[HISTORY_OUTSIDE] = outsideTemp;
+  values[HISTORY_BOILER] = boilerTemp;
+  values[HISTORY_RETURN] = returnWaterTemp;
+  values[HISTORY_EXHAUST] = exhaustTemp;
+  values[HISTORY_DHW] = dhwTemp;
+  history.add(values, timeService.isSynced() ? timeService.utc() : 0);
+}
+
+void publishHistory() {
+  if (historyRequestBlocks == 0 || !hal.mqtt->isConnected()) return;
+  uint32_t size = history.exportSize(historyRequestBlocks);
+  if (hal.mqtt->beginPublish(HISTORY_TOPIC, size, false)) {
+    history.exportTo(*hal.mqtt, historyRequestBlocks);
+    hal.mqtt->endPublish();
+  }
+  historyRequestBlocks = 0;
+}
+
+void publishTrace() {
+  if (!traceRequested || !hal.mqtt->isConnected()) return;
+  if (hal.mqtt->beginPublish(TRACE_TOPIC, otTrace.exportSize(), false)) {
+    otTrace.exportTo(*hal.mqtt);
+    hal.mqtt->endPublish();
+  }
+  traceRequested = false;
+}
+
+void updateOutsideTrend() {
+  outsidePredictor.updateTrend(history, TREND_MINUTES);
+}
+
+void mqttConnected() {
+  hal.mqtt->subscribe(HISTORY_REQUEST_TOPIC);
+  hal.mqtt->subscribe(FORECAST_TOPIC);
+  hal.mqtt->subscribe(ROOM_TEMP_TOPIC);
+  hal.mqtt->subscribe(SCHEDULE_TOPIC);
+  hal.mqtt->subscribe(TRACE_REQUEST_TOPIC);
+}
+
+bool mqttMessage(const char* topic, const uint8_t* payload, uint16_t length) {
+  if (strcmp(topic, FORECAST_TOPIC) == 0) {
+    char text[FORECAST_HOURS * 8];
+    if (length >= sizeof(text)) length = sizeof(text) - 1;
+    memcpy(text, payload, length);
+    text[length] = '\0';
+    if (!outsidePredictor.parseForecast(text)) halLog("Error: Invalid forecast");
+    return true;
+  }
+  if (strcmp(topic, ROOM_TEMP_TOPIC) == 0) {
+    char text[16];
+    if (length >= sizeof(text)) length = sizeof(text) - 1;
+    memcpy(text, payload, length);
+    text[length] = '\0';
+    char* end;
+    float value = strtof(text, &end);
+    if (end == text || value < 0 || value > 40) {
+      halLog("Error: Invalid room temperature");
+    } else {
+      roomTemp = value;
+      roomTempAt = hal.clock->millis();
+      roomTempReceived = true;
+    }
+    return true;
+  }
+  if (strcmp(topic, SCHEDULE_TOPIC) == 0) {
+    WeekSchedule loaded[SCHEDULE_CIRCUITS] = {};
+    if (length > 0 && !parseWeekSchedule((const char*)payload, length, loaded)) {
+      halLog("Error: Invalid schedule");
+      return true;
+    }
+    // written right away, a schedule is sent once and not dragged like a slider
+    memcpy(customSchedule, loaded, sizeof(customSchedule));
+    scheduleStore.save(customSchedule, sizeof(customSchedule));
+    scheduleChanged = true;
+    return true;
+  }
+  if (strcmp(topic, TRACE_REQUEST_TOPIC) == 0) {
+    traceRequested = true;
+    return true;
+  }
+  if (strcmp(topic, HISTORY_REQUEST_TOPIC) != 0) return false;
+  char hours[4] = { 0 };
+  memcpy(hours, payload, length < 3 ? length : 3);
+  int n = atoi(hours);
+  // a started block counts as an hour
+  historyRequestBlocks = (n > 0 && n < HISTORY_BLOCKS) ? n + 1 : HISTORY_BLOCKS;
+  return true;
+}
+
+void captureConfig(ControllerConfig& config) {
+  memset(&config, 0, sizeof(config));  // padding too, the store compares CRCs
+  config.dhwTempMorningSP = dhwTempMorningSP;
+  config.dhwTempDaySP = dhwTempDaySP;
+  config.dhwTempEveningSP = dhwTempEveningSP;
+  config.dhwTempNightSP = dhwTempNightSP;
+  config.dhwLegionellenSP = dhwLegionellenSP;
+  config.dhwTempBoostSP = dhwTempBoostSP;
+  config.boilerTempBoost = boilerTempBoost;
+  config.morningStart = morningStart;
+  config.dayStart = dayStart;
+  config.afternoonStart = afternoonStart;
+  config.nightStart = nightStart;
+  config.steepness = steepness;
+  config.zeroSetpoint = zeroSetpoint;
+  config.tempShiftValue = tempShiftValue;
+  config.curveShape = curveShape;
+  config.legionellaProgramDay = legionellaProgramDay;
+  config.enableHeatingProgram = enableHeatingProgram;
+  config.enableHotWaterProgram = enableHotWaterProgram;
+  config.enableLegionellaProgram = enableLegionellaProgram;
+  config.buildingTimeConstant = buildingTimeConstant;
+  config.roomSetpoint = roomSetpoint;
+  config.optimalStart = optimalStart.table;
+  config.dhwHysteresis = dhwHysteresis;
+}
+
+void applyConfig(const ControllerConfig& config) {
+  dhwTempMorningSP = config.dhwTempMorningSP;
+  dhwTempDaySP = config.dhwTempDaySP;
+  dhwTempEveningSP = config.dhwTempEveningSP;
+  dhwTempNightSP = config.dhwTempNightSP;
+  dhwLegionellenSP = config.dhwLegionellenSP;
+  dhwTempBoostSP = config.dhwTempBoostSP;
+  boilerTempBoost = config.boilerTempBoost;
+  morningStart = config.morningStart;
+  dayStart = config.dayStart;
+  afternoonStart = config.afternoonStart;
+  nightStart = config.nightStart;
+  steepness = config.steepness;
+  zeroSetpoint = config.zeroSetpoint;
+  tempShiftValue = config.tempShiftValue;
+  curveShape = config.curveShape == CURVE_LINEAR ? CURVE_LINEAR : CURVE_CUBIC;
+  legionellaProgramDay = config.legionellaProgramDay;
+  enableHeatingProgram = config.enableHeatingProgram;
+  enableHotWaterProgram = config.enableHotWaterProgram;
+  enableLegionellaProgram = config.enableLegionellaProgram;
+  buildingTimeConstant = config.buildingTimeConstant;
+  roomSetpoint = config.roomSetpoint;
+  optimalStart.table = config.optimalStart;
+  dhwHysteresis = config.dhwHysteresis;
+  scheduleChanged = true;
+}
+
+// Bursts of slider changes from Home Assistant end up in one flash write
+void persistConfig() {
+  ControllerConfig config;
+  captureConfig(config);
+  configStore.update(&config, sizeof(config), hal.clock->millis());
+}
+
+void setupController() {
+  if (hal.flash) {
+    ControllerConfig config;
+    captureConfig(config);  // compiled-in defaults for anything not stored
+    if (configStore.load(*hal.flash, &config, sizeof(config))) applyConfig(config);
+    if (scheduleStore.load(*hal.flash, customSchedule, sizeof(customSchedule))) {
+      for (uint8_t c = 0; c < SCHEDULE_CIRCUITS; c++) {
+        if (customSchedule[c].count > SCHEDULE_MAX_POINTS) customSchedule[c].clear();
+      }
+    }
+  }
+  rebuildSchedule();
+  rebuildHeatingCurve();
+  if (hal.thermostat) {
+    otGateway.begin(hal.thermostat, hal.bus, gatewayOverride);
+    hal.bus->setResponseHandler(gatewayResponse);
+  } else {
+    hal.bus->setResponseHandler(processResponse);
+  }
+  uint8_t boilers = 1;
+  for (uint8_t i = 0; i < HAL_MAX_EXTRA_BUSES; i++) {
+    if (hal.extraBus[i] == nullptr) continue;
+    cascadeBoilers[boilers - 1].begin(hal.extraBus[i], boilers - 1);  // slot = index, see ChannelHooks
+    boilers++;
+  }
+  cascade.begin(boilers, hal.clock->millis());
+}
+
+void addControllerTasks(Scheduler& scheduler) {
+  // name, callback, period [ms], deadline [ms]
+  scheduler.addTask("otProcess", []() { hal.bus->process(); }, 0, 5);
+  scheduler.addTask("otDecode", []() { hal.bus->drain(OT_DECODE_BATCH); }, 0, 5);
+  if (otGateway.active()) {
+    scheduler.addTask("otGateway", forwardThermostat, 0, 5);
+  } else {
+    scheduler.addTask("otQuery", queryDataFromTherme, 0, 5);
+  }
+  scheduler.addTask("heating", manageHeating, 1000, 20);
+  scheduler.addTask("hotWater", manageHotWater, 1000, 20);
+  scheduler.addTask("dayTime", manageDayAndTime, 1000, 1100);  // hourly NTP sync can block up to 1 s
+  scheduler.addTask("lcd", showMain, 1000, 300);
+  scheduler.addTask("history", recordHistory, HISTORY_INTERVAL_MS, 20);
+  scheduler.addTask("trend", updateOutsideTrend, 600000, 50);
+  scheduler.addTask("historyMqtt", publishHistory, 1000, 500);  // up to 15 kB in one publish
+  scheduler.addTask("traceMqtt", publishTrace, 1000, 200);
+  if (hal.flash) scheduler.addTask("config", persistConfig, 1000, 100);  // a sector erase takes up to ~50 ms
+  if (cascade.count() > 1) {
+    scheduler.addTask("cascadeBus", serviceCascadeBuses, 0, 5);
+    scheduler.addTask("cascade", updateCascade, 1000, 20);
+  }
+}
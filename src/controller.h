@@ -0,0 +1,235 @@
+// controller.h
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "scheduler.h"
+#include "lcdframe.h"
+#include "otpoll.h"
+#include "fixedstring.h"
+#include "heatingcurve.h"
+#include "timeservice.h"
+#include "burnercycle.h"
+#include "telemetry.h"
+#include "configstore.h"
+#include "forecast.h"
+#include "pid.h"
+#include "optimalstart.h"
+#include "weekschedule.h"
+#include "cascade.h"
+#include "ottrace.h"
+#include "otgateway.h"
+#include "dhwcharge.h"
+
+// Heating mode enumeration
+enum HeatingMode {
+  OTemp_AUTO,
+  BOOST
+};
+
+// Hot water mode enumeration
+enum HotWaterMode {
+  AUTOMATIC,
+  MANUAL
+};
+
+// Time of day enumeration
+enum TimeOfDay {
+  NIGHT,
+  MORNING,
+  DAY,
+  EVENING
+};
+
+extern HeatingMode heatingMode;
+extern HotWaterMode hotWaterMode;
+
+extern TimeOfDay timeOfDay;
+extern float daytime;
+extern float morningStart;
+extern float dayStart;
+extern float afternoonStart;
+extern float nightStart;
+extern bool scheduleChanged;  // periods or their setpoints changed, rebuild the schedule
+extern OptimalStart optimalStart;
+
+// Weekly schedule of the room and DHW setpoints. A circuit without points loaded over MQTT
+// runs the four day periods above, every day of the week.
+extern WeekSchedule schedule[SCHEDULE_CIRCUITS];
+extern WeekSchedule customSchedule[SCHEDULE_CIRCUITS];
+// Optimal start: point of each circuit that was taken early to be at temperature on time, -1 = none
+extern int8_t preheatPoint[SCHEDULE_CIRCUITS];
+extern float scheduledRoomSP;
+extern float scheduledDhwSP;
+
+// Day of the week and Legionella program day
+extern int dayOfWeek;
+extern int legionellaProgramDay;
+
+// Flags for enabling various functions
+extern bool enableHeatingProgram;
+extern bool enableHotWaterProgram;
+extern bool enableLegionellaProgram;
+
+extern bool enableCentralHeating;
+extern bool enableHotWater;
+extern bool enableCooling;
+
+// Flags indicating current system states
+extern bool isEnabledCentralHeating;
+extern bool isEnabledHotWater;
+extern bool isEnabledFlame;
+
+// Temperature thresholds
+extern float heatingThreshold;
+extern float boilerTempSP;
+extern float boilerTempBoost;
+
+// Hot water temperature setpoints
+extern float dhwTemp;
+extern float dhwTempSP;
+extern float dhwTempNightSP;
+extern float dhwTempMorningSP;
+extern float dhwTempEveningSP;
+extern float dhwTempDaySP;
+extern float dhwLegionellenSP;
+extern float dhwTempBoostSP;
+// DHW charging: the boiler gets the DHW enable only while a charge runs, see DhwChargeManager
+extern float dhwHysteresis;  // [K]
+extern DhwChargeManager dhwCharge;
+
+// Temperature readings
+extern float outsideTemp;
+extern float returnWaterTemp;
+extern float boilerTemp;
+extern float flowRate;  // DHW flow [l/min]
+extern float exhaustTemp;
+
+// Boiler diagnostics
+extern float relModLevel;           // [%]
+extern float chPressure;            // [bar]
+extern bool isFault;                // fault bit of the Status response
+extern uint8_t faultFlags;          // ASF flags: service, lockout, low water, flame, air pressure, overtemperature
+extern uint8_t oemFaultCode;
+extern float burnerStarts;
+extern float burnerOperationHours;
+
+// Heating curve parameters, call rebuildHeatingCurve() after changing them
+extern float nightOffsetFactor;
+extern float tempShiftValue;
+extern CurveShape curveShape;
+extern float steepness;
+extern float zeroSetpoint;
+extern float curvature;
+extern HeatingCurve heatingCurve;
+
+// Predictive curve: the curve and the heating threshold use the outside temperature the building
+// will respond to, see OutsidePredictor. 0 h switches it off.
+extern float buildingTimeConstant;
+extern float predictedOutsideTemp;
+extern OutsidePredictor outsidePredictor;
+
+// Room temperature feedback: a PID trims the curve setpoint while a room temperature arrives
+// over MQTT, without one (or after it went stale) the curve runs open loop
+extern float roomTemp;
+extern float roomSetpoint;
+extern PidController roomPid;
+bool isRoomTempFresh();
+
+// Display-related variables
+extern FixedString<LCD_STATE_WIDTH> state;
+extern FixedString<5> timeString;
+extern LcdFrame frame;
+
+extern OtPollScheduler otPoll;
+extern BurnerCycleManager burnerCycle;
+
+// Boiler cascade, member 0 is the boiler on hal.bus. Only active with an extra bus in hal.
+extern BoilerCascade cascade;
+extern bool heatingDemand;      // heat demand of the building, before the cascade picks the boilers
+extern float cascadeFlowSP;     // flow setpoint of the other boilers, without this boiler's short-cycling hold
+void updateCascade();
+void serviceCascadeBuses();
+// Gateway mode: with hal.thermostat set the room thermostat is the master, its requests are
+// forwarded instead of the own poll schedule. While the heating or hot water program is on,
+// TSet or TdhwSet writes are replaced by the controller's setpoints.
+extern OtGateway otGateway;
+// Latest request/response pairs on the boiler bus, own and forwarded
+extern OtTrace otTrace;
+// Startup timing, the controller marks the first valid OpenTherm response, the platform the rest
+extern BootTimes bootTimes;
+// One sample per minute of the temperatures, 24 h
+extern TelemetryHistory history;
+
+// Settings restored from flash at startup. Bump CONFIG_VERSION when a field changes meaning or
+// is removed, new fields are appended at the end and keep their defaults when loading older blobs.
+#define CONFIG_VERSION 1
+struct ControllerConfig {
+  float dhwTempMorningSP;
+  float dhwTempDaySP;
+  float dhwTempEveningSP;
+  float dhwTempNightSP;
+  float dhwLegionellenSP;
+  float dhwTempBoostSP;
+  float boilerTempBoost;
+  float morningStart;
+  float dayStart;
+  float afternoonStart;
+  float nightStart;
+  float steepness;
+  float zeroSetpoint;
+  float tempShiftValue;
+  uint8_t curveShape;
+  uint8_t legionellaProgramDay;
+  uint8_t enableHeatingProgram;
+  uint8_t enableHotWaterProgram;
+  uint8_t enableLegionellaProgram;
+  float buildingTimeConstant;
+  float roomSetpoint;
+  OptimalStartTable optimalStart;
+  float dhwHysteresis;
+};
+extern ConfigStore configStore;
+
+// The schedule loaded over MQTT has its own store in the sectors after the configuration
+#define CONFIG_SECTORS 4
+#define SCHEDULE_VERSION 1
+extern ConfigStore scheduleStore;
+
+// Provided by the platform (NTP on the board, simulated time on the host)
+extern TimeService timeService;
+
+void rebuildHeatingCurve();
+void processResponse(uint32_t response, OtResponseStatus status, uint32_t ms);
+void gatewayResponse(uint32_t response, OtResponseStatus status, uint32_t ms);
+// The registry stage of both, also used to replay traces
+void decodeResponse(uint32_t response, OtResponseStatus status, uint32_t ms);
+void queryDataFromTherme();
+void forwardThermostat();
+void manageHeating();
+void manageHotWater();
+void manageDayAndTime();
+float dhwSetpointFor(TimeOfDay period);
+void rebuildSchedule();
+void showMain();
+void recordHistory();
+void publishHistory();
+void publishTrace();
+void captureConfig(ControllerConfig& config);
+void applyConfig(const ControllerConfig& config);
+void persistConfig();
+void updateOutsideTrend();
+
+// MQTT topics of the controller: subscribe after every (re)connect,
+// mqttMessage() returns false for topics it does not handle
+void mqttConnected();
+bool mqttMessage(const char* topic, const uint8_t* payload, uint16_t length);
+
+// Call after hal is set up, restores the configuration from hal.flash
+void setupController();
+// Registers the OpenTherm, control and display tasks
+void addControllerTasks(Scheduler& scheduler);
+
+#endif
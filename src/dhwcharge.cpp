@@ -0,0 +1,61 @@
+// dhwcharge.cpp
+
+#include "dhwcharge.h"
+
+DhwChargeManager::DhwChargeManager(const DhwChargeParams& params) : params(params) {}
+
+bool DhwChargeManager::update(float tankTemp, float setpoint, bool forced, uint32_t now) {
+  bool forceStart = forced && !wasForced;
+  wasForced = forced;
+
+  if (active) {
+    if (setpoint <= 0 || tankTemp >= setpoint) finish(tankTemp, now);
+    return active;
+  }
+  if (setpoint <= 0) return false;
+
+  if ((forceStart && tankTemp < setpoint) || tankTemp < setpoint - params.hysteresis) begin(tankTemp, now);
+  return active;
+}
+
+void DhwChargeManager::begin(float tankTemp, uint32_t now) {
+  active = true;
+  startedAt = now;
+  running = { 0, 0, 0.0, tankTemp, tankTemp };
+}
+
+void DhwChargeManager::finish(float tankTemp, uint32_t now) {
+  active = false;
+  running.durationMs = now - startedAt;
+  running.endTemp = tankTemp;
+  finished = running;
+  chargeCount++;
+  todayCharges++;
+}
+
+void DhwChargeManager::boilerUpdate(bool dhwActive, bool flameOn, float flowTemp, float returnTemp, uint32_t now) {
+  // the power since the previous response, a gap (bus timeouts) is left out rather than guessed
+  uint32_t dt = now - lastUpdate;
+  if (updated && burning && dt <= params.maxGapMs) {
+    float kWh = power * dt / 3.6e9;
+    today += kWh;
+    total += kWh;
+    if (active) {
+      running.kWh += kWh;
+      running.burnerMs += dt;
+    }
+  }
+  burning = dhwActive && flameOn;
+  power = burning && flowTemp > returnTemp ? params.primaryFlow * (flowTemp - returnTemp) : 0.0;
+  lastUpdate = now;
+  updated = true;
+}
+
+void DhwChargeManager::dayChange(uint8_t day) {
+  if (lastDay >= 0 && day != lastDay) {
+    yesterday = today;
+    today = 0.0;
+    todayCharges = 0;
+  }
+  lastDay = day;
+}
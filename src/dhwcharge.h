@@ -0,0 +1,73 @@
+// dhwcharge.h
+
+#ifndef DHWCHARGE_H
+#define DHWCHARGE_H
+
+#include <stdint.h>
+
+struct DhwChargeParams {
+  float hysteresis;   // a charge starts once the tank is this far below the setpoint [K]
+  float primaryFlow;  // mass flow * cp of the boiler water through the tank coil [W/K]
+  uint32_t maxGapMs;  // Status responses further apart are not integrated
+};
+
+// One charge, from the start to the tank reaching the setpoint
+struct DhwCharge {
+  uint32_t durationMs;
+  uint32_t burnerMs;  // flame on in DHW mode
+  float kWh;          // primary flow * (flow - return) over the burner time
+  float startTemp;
+  float endTemp;
+};
+
+// Charges the DHW tank in batches instead of keeping it at the setpoint: the boiler only gets
+// the DHW enable while a charge runs, so its own (often small) DHW hysteresis cannot reheat a
+// warm tank. A charge starts when the tank fell by the hysteresis and stops at the setpoint.
+// The heat the boiler puts into the tank is counted per charge and per day.
+class DhwChargeManager {
+public:
+  explicit DhwChargeManager(const DhwChargeParams& params);
+
+  // Whether the tank is charged now, call about once per second. setpoint <= 0 stops any charge.
+  // A rising edge of forced (boost, Legionella) starts a charge right away below the setpoint.
+  bool update(float tankTemp, float setpoint, bool forced, uint32_t now);
+  // Feed every successful Status response with the latest flow and return temperatures
+  void boilerUpdate(bool dhwActive, bool flameOn, float flowTemp, float returnTemp, uint32_t now);
+  // Day of the week, the daily figures roll over when it changes
+  void dayChange(uint8_t day);
+
+  bool charging() const { return active; }
+  const DhwCharge& current() const { return running; }
+  const DhwCharge& last() const { return finished; }
+  uint32_t charges() const { return chargeCount; }
+  uint32_t chargesToday() const { return todayCharges; }
+  float todayKWh() const { return today; }
+  float yesterdayKWh() const { return yesterday; }
+  float totalKWh() const { return total; }
+
+  DhwChargeParams params;
+
+private:
+  void begin(float tankTemp, uint32_t now);
+  void finish(float tankTemp, uint32_t now);
+
+  bool active = false;
+  bool wasForced = false;
+  uint32_t startedAt = 0;
+  DhwCharge running = {};
+  DhwCharge finished = {};
+  uint32_t chargeCount = 0;
+  uint32_t todayCharges = 0;
+
+  // energy integration between Status responses
+  bool burning = false;
+  float power = 0.0;  // [W]
+  uint32_t lastUpdate = 0;
+  bool updated = false;
+  float today = 0.0;
+  float yesterday = 0.0;
+  float total = 0.0;
+  int16_t lastDay = -1;
+};
+
+#endif
@@ -0,0 +1,80 @@
+// fixedstring.cpp
+
+#include "fixedstring.h"
+
+// Copies the reversed digits in rev to out, left padded to width, cut to size - 1
+static uint8_t emit(char* out, uint8_t size, const char* rev, uint8_t n, uint8_t width, char pad) {
+  if (size == 0) return 0;
+  uint8_t len = 0;
+  for (uint8_t i = n; i < width && len < size - 1; i++) out[len++] = pad;
+  while (n > 0 && len < size - 1) out[len++] = rev[--n];
+  out[len] = '\0';
+  return len;
+}
+
+uint8_t formatInt(char* out, uint8_t size, int32_t value, uint8_t width, char pad) {
+  char rev[12];
+  uint8_t n = 0;
+  bool negative = value < 0;
+  uint32_t v = negative ? 0u - (uint32_t)value : (uint32_t)value;
+  do {
+    rev[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+  if (negative && pad == '0') {
+    // sign goes in front of the zero padding: -07
+    if (size < 2) return emit(out, size, rev, 0, 0, pad);
+    out[0] = '-';
+    return 1 + emit(out + 1, size - 1, rev, n, width > 0 ? width - 1 : 0, pad);
+  }
+  if (negative) rev[n++] = '-';
+  return emit(out, size, rev, n, width, pad);
+}
+
+uint8_t formatUint(char* out, uint8_t size, uint32_t value, uint8_t width, char pad) {
+  char rev[10];
+  uint8_t n = 0;
+  do {
+    rev[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  return emit(out, size, rev, n, width, pad);
+}
+
+uint8_t formatHex(char* out, uint8_t size, uint32_t value, uint8_t width) {
+  static const char digits[] = "0123456789abcdef";
+  char rev[8];
+  uint8_t n = 0;
+  do {
+    rev[n++] = digits[value & 0xF];
+    value >>= 4;
+  } while (value > 0);
+  return emit(out, size, rev, n, width, '0');
+}
+
+uint8_t formatFloat(char* out, uint8_t size, float value, uint8_t decimals) {
+  if (value != value) return emit(out, size, "nan", 3, 0, ' ');  // NaN, reversed "nan" reads the same
+  if (decimals > 3) decimals = 3;
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+  bool negative = value < 0;
+  float absValue = negative ? -value : value;
+  if (absValue > 999999.0f) absValue = 999999.0f;
+  uint32_t scaled = (uint32_t)(absValue * scale + 0.5f);
+
+  char rev[12];
+  uint8_t n = 0;
+  // "-0" reads odd, drop the sign if the rounded value is zero
+  if (scaled == 0) negative = false;
+  for (uint8_t i = 0; i < decimals; i++) {
+    rev[n++] = '0' + scaled % 10;
+    scaled /= 10;
+  }
+  if (decimals > 0) rev[n++] = '.';
+  do {
+    rev[n++] = '0' + scaled % 10;
+    scaled /= 10;
+  } while (scaled > 0);
+  if (negative) rev[n++] = '-';
+  return emit(out, size, rev, n, 0, ' ');
+}
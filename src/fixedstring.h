@@ -0,0 +1,68 @@
+// fixedstring.h
+
+#ifndef FIXEDSTRING_H
+#define FIXEDSTRING_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Number formatting into caller provided buffers, no heap involved.
+// All functions write at most size - 1 characters plus '\0' and return the length written.
+uint8_t formatInt(char* out, uint8_t size, int32_t value, uint8_t width = 0, char pad = ' ');
+uint8_t formatUint(char* out, uint8_t size, uint32_t value, uint8_t width = 0, char pad = ' ');
+uint8_t formatHex(char* out, uint8_t size, uint32_t value, uint8_t width = 0);
+uint8_t formatFloat(char* out, uint8_t size, float value, uint8_t decimals);
+
+// String with a fixed capacity of N characters on the stack or in .bss, appends are cut at N
+template <uint8_t N>
+class FixedString {
+public:
+  FixedString() { clear(); }
+  FixedString(const char* text) { set(text); }
+
+  FixedString& operator=(const char* text) { return set(text); }
+
+  FixedString& clear() {
+    len = 0;
+    buf[0] = '\0';
+    return *this;
+  }
+  FixedString& set(const char* text) {
+    clear();
+    return append(text);
+  }
+  FixedString& append(const char* text) {
+    while (len < N && *text != '\0') buf[len++] = *text++;
+    buf[len] = '\0';
+    return *this;
+  }
+  FixedString& append(char c) {
+    if (len < N) buf[len++] = c;
+    buf[len] = '\0';
+    return *this;
+  }
+  // width pads on the left, e.g. appendInt(7, 2, '0') -> "07"
+  FixedString& appendInt(int32_t value, uint8_t width = 0, char pad = ' ') {
+    len += formatInt(buf + len, N + 1 - len, value, width, pad);
+    return *this;
+  }
+  FixedString& appendHex(uint32_t value, uint8_t width = 0) {
+    len += formatHex(buf + len, N + 1 - len, value, width);
+    return *this;
+  }
+  FixedString& appendFloat(float value, uint8_t decimals) {
+    len += formatFloat(buf + len, N + 1 - len, value, decimals);
+    return *this;
+  }
+
+  const char* c_str() const { return buf; }
+  uint8_t length() const { return len; }
+  static uint8_t capacity() { return N; }
+  bool operator==(const char* text) const { return strcmp(buf, text) == 0; }
+
+private:
+  char buf[N + 1];
+  uint8_t len;
+};
+
+#endif
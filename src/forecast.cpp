@@ -0,0 +1,81 @@
+// forecast.cpp
+
+#include <math.h>
+#include <stdlib.h>
+#include "forecast.h"
+
+void OutsidePredictor::updateTrend(const TelemetryHistory& history, uint16_t minutes) {
+  // x = minutes ago, so the fitted slope is negated
+  float n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  history.forEachRecent(HISTORY_OUTSIDE, minutes, [&](uint32_t x, float y) {
+    n++;
+    sx += x;
+    sy += y;
+    sxx += (float)x * x;
+    sxy += x * y;
+  });
+  float d = n * sxx - sx * sx;
+  // half an hour of samples at least, otherwise no trend
+  slope = (n >= 30 && d > 0) ? -(n * sxy - sx * sy) / d * 60 : 0.0;
+}
+
+void OutsidePredictor::setForecast(uint32_t startUtc, const float* values, uint8_t count) {
+  if (count > FORECAST_HOURS) count = FORECAST_HOURS;
+  for (uint8_t i = 0; i < count; i++) forecast[i] = values[i];
+  forecastStart = startUtc;
+  forecastCount = count;
+}
+
+bool OutsidePredictor::parseForecast(const char* payload) {
+  char* end;
+  uint32_t start = strtoul(payload, &end, 10);
+  if (end == payload || start == 0) return false;
+  float values[FORECAST_HOURS];
+  uint8_t count = 0;
+  while (*end == ',' && count < FORECAST_HOURS) {
+    const char* p = end + 1;
+    values[count] = strtof(p, &end);
+    if (end == p) return false;
+    count++;
+  }
+  if (count < 2) return false;
+  setForecast(start, values, count);
+  return true;
+}
+
+bool OutsidePredictor::hasForecast(uint32_t utc) const {
+  if (forecastCount < 2 || utc < forecastStart) return false;
+  uint32_t end = forecastStart + (forecastCount - 1) * 3600UL;
+  return utc - forecastStart < FORECAST_MAX_AGE_S && utc < end;
+}
+
+float OutsidePredictor::forecastAt(uint32_t utc) const {
+  float hours = (utc - forecastStart) / 3600.0;
+  uint8_t i = hours;
+  if (i >= forecastCount - 1) return forecast[forecastCount - 1];
+  return forecast[i] + (hours - i) * (forecast[i + 1] - forecast[i]);
+}
+
+float OutsidePredictor::effective(float measured, uint32_t utc, float timeConstantH) const {
+  if (timeConstantH <= 0) return measured;
+  float shift;
+  if (hasForecast(utc)) {
+    // exp weighted mean of the forecast change over the next three time constants
+    float now = forecastAt(utc);
+    float sum = 0, weights = 0;
+    for (uint8_t k = 0; k <= 3 * timeConstantH && k < FORECAST_HOURS; k++) {
+      uint32_t t = utc + k * 3600UL;
+      if (t > forecastStart + (forecastCount - 1) * 3600UL) break;
+      float w = expf(-k / timeConstantH);
+      sum += w * (forecastAt(t) - now);
+      weights += w;
+    }
+    shift = sum / weights;
+  } else {
+    // the weighted mean of a linear trend is the trend one time constant ahead
+    shift = slope * (timeConstantH < PREDICT_MAX_LEAD_H ? timeConstantH : PREDICT_MAX_LEAD_H);
+  }
+  if (shift > PREDICT_MAX_SHIFT) shift = PREDICT_MAX_SHIFT;
+  if (shift < -PREDICT_MAX_SHIFT) shift = -PREDICT_MAX_SHIFT;
+  return measured + shift;
+}
@@ -0,0 +1,45 @@
+// forecast.h
+
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#include <stdint.h>
+#include "telemetry.h"
+
+// Hourly values of a pushed forecast
+#define FORECAST_HOURS 48
+// A forecast older than this is ignored
+#define FORECAST_MAX_AGE_S (12UL * 3600)
+// The local trend is not extrapolated further than this
+#define PREDICT_MAX_LEAD_H 3.0
+// Largest difference between the predicted and the measured outside temperature
+#define PREDICT_MAX_SHIFT 6.0
+
+// Predicts the outside temperature a slow building responds to: the coming temperatures weighted
+// with exp(-t / time constant), from a pushed forecast if there is a current one, otherwise from
+// the trend of the measured values in the history
+class OutsidePredictor {
+public:
+  // Least squares slope of the outside temperature over the last minutes of the history
+  void updateTrend(const TelemetryHistory& history, uint16_t minutes);
+  // values[i] is the forecast for startUtc + i hours
+  void setForecast(uint32_t startUtc, const float* values, uint8_t count);
+  // Parses "<start utc>,<t0>,<t1>,..." as sent to the forecast topic, false if malformed
+  bool parseForecast(const char* payload);
+
+  // Outside temperature for the heating curve, the measured value if timeConstantH is 0
+  float effective(float measured, uint32_t utc, float timeConstantH) const;
+
+  float trendPerHour() const { return slope; }
+  bool hasForecast(uint32_t utc) const;
+
+private:
+  float forecastAt(uint32_t utc) const;
+
+  float slope = 0.0;  // [K/h]
+  uint32_t forecastStart = 0;
+  uint8_t forecastCount = 0;
+  float forecast[FORECAST_HOURS];
+};
+
+#endif
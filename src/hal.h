@@ -0,0 +1,121 @@
+// hal.h
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "otframe.h"
+#include "otqueue.h"
+
+// Thin hardware abstraction between the control logic and the board.
+// The ESP8266 implementations live in hal_esp8266.h, the host fakes in sim/.
+
+typedef void (*OtResponseHandler)(uint32_t response, OtResponseStatus status, uint32_t ms);
+
+// OpenTherm master interface, one request in flight at a time
+class OtBus {
+public:
+  virtual ~OtBus() {}
+  virtual bool isReady() = 0;
+  virtual bool sendRequestAsync(uint32_t request) = 0;
+  // Drives the bus state machine, responses are captured into the frame queue from here
+  virtual void process() = 0;
+  void setResponseHandler(OtResponseHandler handler) { responseHandler = handler; }
+
+  // Decoder stage: hands at most maxFrames captured responses to the handler, returns the count
+  uint8_t drain(uint8_t maxFrames) {
+    OtFrame f;
+    uint8_t n = 0;
+    while (n < maxFrames && frames.pop(f)) {
+      if (responseHandler) responseHandler(f.frame, f.status, f.ms);
+      n++;
+    }
+    return n;
+  }
+
+  OtFrameQueue frames;
+
+protected:
+  OtResponseHandler responseHandler = nullptr;
+};
+
+// OpenTherm slave interface towards a room thermostat, for the gateway mode. Requests are
+// captured into the frame queue, each one is answered with sendResponse().
+class OtSlavePort {
+public:
+  virtual ~OtSlavePort() {}
+  virtual bool sendResponse(uint32_t response) = 0;
+  // Drives the slave state machine, requests are captured from here
+  virtual void process() = 0;
+
+  OtFrameQueue frames;
+};
+
+// Character display, the interface LcdFrame::flush() needs
+class CharDisplay {
+public:
+  virtual ~CharDisplay() {}
+  virtual void setCursor(uint8_t col, uint8_t row) = 0;
+  virtual size_t write(uint8_t c) = 0;
+};
+
+class Clock {
+public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+};
+
+// Network and MQTT broker connection
+class MqttLink {
+public:
+  virtual ~MqttLink() {}
+  virtual bool isNetworkConnected() = 0;
+  virtual int16_t rssi() = 0;
+  virtual void localIp(uint8_t ip[4]) = 0;
+  virtual bool isConnected() = 0;
+  // Streamed publish for payloads that are not in one buffer, length must be known up front
+  virtual bool beginPublish(const char* topic, uint16_t length, bool retained) = 0;
+  virtual void writePayload(const uint8_t* data, uint16_t length) = 0;
+  virtual bool endPublish() = 0;
+  virtual bool subscribe(const char* topic) = 0;
+
+  bool publish(const char* topic, const uint8_t* payload, uint16_t length, bool retained) {
+    if (!beginPublish(topic, length, retained)) return false;
+    writePayload(payload, length);
+    return endPublish();
+  }
+};
+
+// Sectors of NOR flash reserved for the controller. Erased bytes read 0xFF, writes can only
+// clear bits. Addresses are relative to the first reserved sector, data and lengths 4-byte aligned.
+class Flash {
+public:
+  virtual ~Flash() {}
+  virtual uint32_t sectorSize() = 0;
+  virtual uint16_t sectorCount() = 0;
+  virtual bool read(uint32_t address, void* data, uint32_t length) = 0;
+  virtual bool write(uint32_t address, const void* data, uint32_t length) = 0;
+  virtual bool eraseSector(uint16_t sector) = 0;
+};
+
+// OpenTherm interfaces to further boilers of a cascade, see cascade.h
+#define HAL_MAX_EXTRA_BUSES 2
+
+struct Hal {
+  OtBus* bus;
+  CharDisplay* display;
+  Clock* clock;
+  MqttLink* mqtt;
+  Flash* flash;
+  OtBus* extraBus[HAL_MAX_EXTRA_BUSES];  // nullptr = not fitted
+  OtSlavePort* thermostat;               // gateway mode, nullptr = the controller is the master
+};
+
+// Set once by the platform setup before the controller runs
+extern Hal hal;
+
+// Diagnostic output, Serial on the board and stderr on the host
+void halLog(const char* message);
+
+#endif
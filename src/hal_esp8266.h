@@ -0,0 +1,101 @@
+// hal_esp8266.h
+
+#ifndef HAL_ESP8266_H
+#define HAL_ESP8266_H
+
+#include <Arduino.h>
+#include <OpenTherm.h>
+#include <LiquidCrystal_PCF8574.h>
+#include <ESP8266WiFi.h>
+#include <ArduinoHA.h>
+#include <flash_hal.h>
+#include "hal.h"
+
+// HAL implementations on top of the board libraries
+
+class OpenThermBus : public OtBus {
+public:
+  explicit OpenThermBus(OpenTherm& ot) : ot(ot) {}
+  bool isReady() override { return ot.isReady(); }
+  bool sendRequestAsync(uint32_t request) override { return ot.sendRequestAync(request); }
+  void process() override { ot.process(); }
+  // Called from the OpenTherm library response callback, decoding happens later in drain()
+  void dispatch(unsigned long response, OpenThermResponseStatus status) {
+    frames.push(response, (OtResponseStatus)status, ::millis());
+  }
+
+private:
+  OpenTherm& ot;
+};
+
+// The OpenTherm library in slave mode, facing the room thermostat
+class OpenThermSlavePort : public OtSlavePort {
+public:
+  explicit OpenThermSlavePort(OpenTherm& ot) : ot(ot) {}
+  bool sendResponse(uint32_t response) override { return ot.sendResponse(response); }
+  void process() override { ot.process(); }
+  // Called from the OpenTherm library request callback
+  void capture(unsigned long request, OpenThermResponseStatus status) {
+    frames.push(request, (OtResponseStatus)status, ::millis());
+  }
+
+private:
+  OpenTherm& ot;
+};
+
+class LcdDisplay : public CharDisplay {
+public:
+  explicit LcdDisplay(LiquidCrystal_PCF8574& lcd) : lcd(lcd) {}
+  void setCursor(uint8_t col, uint8_t row) override { lcd.setCursor(col, row); }
+  size_t write(uint8_t c) override { return lcd.write(c); }
+
+private:
+  LiquidCrystal_PCF8574& lcd;
+};
+
+class ArduinoClock : public Clock {
+public:
+  uint32_t millis() override { return ::millis(); }
+};
+
+// The first sectors of the filesystem area, the firmware does not mount a filesystem.
+// Uploading a filesystem image wipes the stored configuration.
+class EspFlash : public Flash {
+public:
+  explicit EspFlash(uint16_t sectors) : sectors(sectors) {}
+  uint32_t sectorSize() override { return FLASH_SECTOR_SIZE; }
+  uint16_t sectorCount() override { return sectors; }
+  bool read(uint32_t address, void* data, uint32_t length) override {
+    return ESP.flashRead(FS_PHYS_ADDR + address, (uint32_t*)data, length);
+  }
+  bool write(uint32_t address, const void* data, uint32_t length) override {
+    return ESP.flashWrite(FS_PHYS_ADDR + address, (uint32_t*)data, length);
+  }
+  bool eraseSector(uint16_t sector) override { return ESP.flashEraseSector(FS_PHYS_ADDR / FLASH_SECTOR_SIZE + sector); }
+
+private:
+  uint16_t sectors;
+};
+
+class HaMqttLink : public MqttLink {
+public:
+  explicit HaMqttLink(HAMqtt& mqtt) : mqtt(mqtt) {}
+  bool isNetworkConnected() override { return WiFi.status() == WL_CONNECTED; }
+  int16_t rssi() override { return WiFi.RSSI(); }
+  void localIp(uint8_t ip[4]) override {
+    IPAddress address = WiFi.localIP();
+    for (uint8_t i = 0; i < 4; i++) ip[i] = address[i];
+  }
+  bool isConnected() override { return mqtt.isConnected(); }
+  bool beginPublish(const char* topic, uint16_t length, bool retained) override {
+    return mqtt.beginPublish(topic, length, retained);
+  }
+  void writePayload(const uint8_t* data, uint16_t length) override { mqtt.writePayload(data, length); }
+  bool endPublish() override { return mqtt.endPublish(); }
+  bool subscribe(const char* topic) override { return mqtt.subscribe(topic); }
+
+private:
+  HAMqtt& mqtt;
+};
+
+#endif
@@ -0,0 +1,34 @@
+// hapublish.cpp
+
+#include "hapublish.h"
+
+SensorPublishFilter::SensorPublishFilter(float deadband, uint32_t maxAgeMs)
+  : deadband(deadband), maxAgeMs(maxAgeMs) {}
+
+bool SensorPublishFilter::update(float value, uint32_t now) {
+  return accept(value, now, true);
+}
+
+bool SensorPublishFilter::changed(float value, uint32_t now) {
+  return accept(value, now, false);
+}
+
+bool SensorPublishFilter::accept(float value, uint32_t now, bool heartbeat) {
+  float delta = value - lastValue;
+  if (delta < 0) delta = -delta;
+  if (sent && delta <= deadband && (!heartbeat || now - lastSent < maxAgeMs)) {
+    suppressed++;
+    return false;
+  }
+  lastValue = value;
+  lastSent = now;
+  sent = true;
+  published++;
+  return true;
+}
+
+bool AvailabilityFilter::update(bool available) {
+  if (last == (int8_t)available) return false;
+  last = available;
+  return true;
+}
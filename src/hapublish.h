@@ -0,0 +1,46 @@
+// hapublish.h
+
+#ifndef HAPUBLISH_H
+#define HAPUBLISH_H
+
+#include <stdint.h>
+
+// Remembers the last published value of a sensor and decides when the next one is due:
+// after a move of more than the deadband or when the heartbeat age runs out
+class SensorPublishFilter {
+public:
+  SensorPublishFilter(float deadband, uint32_t maxAgeMs);
+
+  // Returns true (and records the value as sent) if it should be published now
+  bool update(float value, uint32_t now);
+  // Same without the heartbeat, only the first value and moves past the deadband pass. For the
+  // outbox while offline, where heartbeats of unchanged values would push out real changes.
+  bool changed(float value, uint32_t now);
+  // Publish the next value regardless, e.g. after an MQTT reconnect
+  void reset() { sent = false; }
+
+  float deadband;
+  uint32_t maxAgeMs;
+  uint32_t published = 0;
+  uint32_t suppressed = 0;
+
+private:
+  bool accept(float value, uint32_t now, bool heartbeat);
+
+  float lastValue = 0.0;
+  uint32_t lastSent = 0;
+  bool sent = false;
+};
+
+// Availability is only sent when it actually changes
+class AvailabilityFilter {
+public:
+  // Returns true if the availability differs from the last one sent
+  bool update(bool available);
+  void reset() { last = -1; }
+
+private:
+  int8_t last = -1;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// heapstats.cpp
+
+#include "heapstats.h"
+
+void HeapMonitor::samplePass(uint32_t heap) {
+  if (passes > 0 && heap != freeHeap) changedPasses++;
+  passes++;
+  freeHeap = heap;
+  if (heap < minFreeHeap) minFreeHeap = heap;
+}
+
+void HeapMonitor::sampleFragmentation(uint8_t fragmentationPercent, uint32_t maxFreeBlock) {
+  fragmentation = fragmentationPercent;
+  if (fragmentationPercent > maxFragmentation) maxFragmentation = fragmentationPercent;
+  if (maxFreeBlock < minMaxFreeBlock) minMaxFreeBlock = maxFreeBlock;
+}
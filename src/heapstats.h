@@ -0,0 +1,27 @@
+// heapstats.h
+
+#ifndef HEAPSTATS_H
+#define HEAPSTATS_H
+
+#include <stdint.h>
+
+// Tracks the heap low-water mark and fragmentation over the uptime
+class HeapMonitor {
+public:
+  // Call once per loop() pass with the current free heap
+  void samplePass(uint32_t freeHeap);
+  // Call periodically, reading the fragmentation walks the heap and is slower
+  void sampleFragmentation(uint8_t fragmentationPercent, uint32_t maxFreeBlock);
+
+  uint32_t freeHeap = 0;
+  uint32_t minFreeHeap = UINT32_MAX;     // high-water mark of heap usage
+  uint8_t fragmentation = 0;
+  uint8_t maxFragmentation = 0;
+  uint32_t minMaxFreeBlock = UINT32_MAX;
+  uint32_t passes = 0;
+  // passes after which the free heap differed from the pass before; this also
+  // counts allocations of the WiFi/lwIP stack, so it is an upper bound for ours
+  uint32_t changedPasses = 0;
+};
+
+#endif
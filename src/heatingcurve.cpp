@@ -0,0 +1,40 @@
+// heatingcurve.cpp
+
+#include "heatingcurve.h"
+
+static float cubicCurve(float x, const HeatingCurveParams& p) {
+  return p.steepness * x - p.curvature * x * x * x + p.zeroSetpoint;
+}
+
+static float linearCurve(float x, const HeatingCurveParams& p) {
+  return p.steepness * x + p.zeroSetpoint;
+}
+
+CurveFunction HeatingCurve::function(CurveShape shape) {
+  switch (shape) {
+    case CURVE_LINEAR: return linearCurve;
+    case CURVE_CUBIC:
+    default: return cubicCurve;
+  }
+}
+
+void HeatingCurve::build(const HeatingCurveParams& params) {
+  current = params;
+  CurveFunction f = function(params.shape);
+  for (int16_t i = 0; i < CURVE_TABLE_SIZE; i++) {
+    float outside = CURVE_MIN_TEMP + (float)i / CURVE_STEPS_PER_K;
+    float sp = f(outside + params.shift, params);
+    if (sp > 320.0f) sp = 320.0f;  // keep within int16_t centi-kelvin
+    if (sp < -320.0f) sp = -320.0f;
+    table[i] = (int16_t)(sp * 100.0f + (sp < 0 ? -0.5f : 0.5f));
+  }
+}
+
+float HeatingCurve::setpoint(float outsideTemp) const {
+  float pos = (outsideTemp - CURVE_MIN_TEMP) * CURVE_STEPS_PER_K;
+  if (!(pos > 0)) return table[0] / 100.0f;  // also catches NaN
+  if (pos >= CURVE_TABLE_SIZE - 1) return table[CURVE_TABLE_SIZE - 1] / 100.0f;
+  int16_t i = (int16_t)pos;
+  float frac = pos - i;
+  return (table[i] + (table[i + 1] - table[i]) * frac) / 100.0f;
+}
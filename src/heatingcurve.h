@@ -0,0 +1,46 @@
+// heatingcurve.h
+
+#ifndef HEATINGCURVE_H
+#define HEATINGCURVE_H
+
+#include <stdint.h>
+
+// Outside temperature range and resolution of the lookup table
+#define CURVE_MIN_TEMP -30
+#define CURVE_MAX_TEMP 30
+#define CURVE_STEPS_PER_K 4
+#define CURVE_TABLE_SIZE ((CURVE_MAX_TEMP - CURVE_MIN_TEMP) * CURVE_STEPS_PER_K + 1)
+
+enum CurveShape : uint8_t {
+  CURVE_CUBIC,   // steepness * x - curvature * x^3 + zeroSetpoint
+  CURVE_LINEAR   // steepness * x + zeroSetpoint
+};
+
+struct HeatingCurveParams {
+  CurveShape shape;
+  float steepness;
+  float zeroSetpoint;  // flow temperature at x = 0
+  float curvature;     // cubic term, ignored by the linear curve
+  float shift;         // added to the outside temperature before the curve is applied
+};
+
+// Flow temperature for a shifted outside temperature x, one per shape
+typedef float (*CurveFunction)(float x, const HeatingCurveParams& params);
+
+// Heating curve evaluated once into a table, linear interpolation at runtime
+class HeatingCurve {
+public:
+  // Recompute the table, call at startup and whenever a parameter changes
+  void build(const HeatingCurveParams& params);
+  // Flow temperature setpoint, outside temperatures beyond the table use the end values
+  float setpoint(float outsideTemp) const;
+
+  const HeatingCurveParams& params() const { return current; }
+  static CurveFunction function(CurveShape shape);
+
+private:
+  HeatingCurveParams current = { CURVE_CUBIC, 0, 0, 0, 0 };
+  int16_t table[CURVE_TABLE_SIZE] = { 0 };  // setpoints in 1/100 K
+};
+
+#endif
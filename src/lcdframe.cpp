@@ -0,0 +1,74 @@
+// lcdframe.cpp
+
+#include "lcdframe.h"
+#include "fixedstring.h"
+#include <string.h>
+
+LcdFrame::LcdFrame() {
+  clear();
+  invalidate();
+}
+
+void LcdFrame::clear() {
+  memset(cells, ' ', sizeof(cells));
+}
+
+void LcdFrame::invalidate() {
+  // 0 is a custom character slot and never drawn by us, so every cell differs
+  memset(shown, 0, sizeof(shown));
+}
+
+void LcdFrame::print(uint8_t col, uint8_t row, const char* text, uint8_t width) {
+  if (row >= LCD_ROWS || col >= LCD_COLS) return;
+  if (width == 0) width = strlen(text);
+  if (col + width > LCD_COLS) width = LCD_COLS - col;
+  char* cell = &cells[row][col];
+  uint8_t i = 0;
+  for (; i < width && text[i] != '\0'; i++) cell[i] = text[i];
+  for (; i < width; i++) cell[i] = ' ';
+}
+
+void LcdFrame::printNumber(uint8_t col, uint8_t row, float value, uint8_t width, uint8_t decimals) {
+  char buf[LCD_COLS + 1];
+  uint8_t len = formatFloat(buf, sizeof(buf), value, decimals);
+  if (len > width) {
+    memset(buf, '*', width);
+    buf[width] = '\0';
+  }
+  print(col, row, buf, width);
+}
+
+bool LcdFrame::nextRun(uint8_t row, uint8_t col, uint8_t& start, uint8_t& end) const {
+  const char* want = cells[row];
+  const char* have = shown[row];
+  while (col < LCD_COLS && want[col] == have[col]) col++;
+  if (col >= LCD_COLS) return false;
+
+  start = col;
+  end = col + 1;
+  while (end < LCD_COLS) {
+    if (want[end] != have[end]) {
+      end++;
+      continue;
+    }
+    // rewriting one clean cell costs the same as a cursor move, longer gaps split the run
+    uint8_t gap = end;
+    while (gap < LCD_COLS && want[gap] == have[gap]) gap++;
+    if (gap >= LCD_COLS || gap - end > 1) break;
+    end = gap;
+  }
+  return true;
+}
+
+uint8_t formatBoilerState(char* out, uint8_t size, bool flameOn, bool fault, uint8_t oemFaultCode) {
+  if (size == 0) return 0;
+  if (!fault) {
+    strncpy(out, flameOn ? "FlameOn " : "noFlame ", size - 1);
+    out[size - 1] = '\0';
+    return strlen(out);
+  }
+  strncpy(out, "Err ", size - 1);
+  out[size - 1] = '\0';
+  uint8_t len = strlen(out);
+  return len + formatInt(out + len, size - len, oemFaultCode);
+}
@@ -0,0 +1,91 @@
+// lcdframe.h
+
+#ifndef LCDFRAME_H
+#define LCDFRAME_H
+
+#include <stdint.h>
+
+#define LCD_COLS 20
+#define LCD_ROWS 4
+// Boiler state field at the start of the 2nd row
+#define LCD_STATE_WIDTH 8
+
+// LiquidCrystal_PCF8574 sends every LCD byte (char or command) as one I2C
+// transmission: address byte + 2 nibbles with and without the enable bit
+#define LCD_I2C_BYTES_PER_WRITE 5
+
+// Traffic of one flush() towards the display
+struct LcdFlushStats {
+  uint16_t chars;        // characters sent
+  uint16_t cursorMoves;  // setCursor() commands sent
+  uint16_t i2cBytes;     // resulting bytes on the I2C bus
+};
+
+// Text of the boiler state field: "FlameOn ", "noFlame " or "Err <OEM code>", the prefix
+// leaves room for all three digits of the code. Returns the length.
+uint8_t formatBoilerState(char* out, uint8_t size, bool flameOn, bool fault, uint8_t oemFaultCode);
+
+// Shadow framebuffer for a 20x4 character display. Drawing only touches RAM,
+// flush() sends the cells that differ from what the display currently shows.
+class LcdFrame {
+public:
+  LcdFrame();
+
+  // Fill the back buffer with spaces
+  void clear();
+  // Forget what the display shows, the next flush() redraws every cell
+  void invalidate();
+
+  // Write text at col/row, padded with spaces (or cut) to width; width 0 = text length
+  void print(uint8_t col, uint8_t row, const char* text, uint8_t width = 0);
+  // Left aligned fixed width number, '*' filled if it does not fit
+  void printNumber(uint8_t col, uint8_t row, float value, uint8_t width, uint8_t decimals = 0);
+
+  // Send all changed runs to the display, Lcd needs setCursor(col, row) and write(uint8_t)
+  template <class Lcd>
+  LcdFlushStats flush(Lcd& lcd);
+
+  const LcdFlushStats& lastFlush() const { return last; }
+  uint32_t totalI2cBytes() const { return totalBytes; }
+
+private:
+  // Finds the next run of changed cells in row starting at col, merging runs
+  // that are closer than a cursor move. Returns false if the rest of the row is clean.
+  bool nextRun(uint8_t row, uint8_t col, uint8_t& start, uint8_t& end) const;
+
+  char cells[LCD_ROWS][LCD_COLS];
+  char shown[LCD_ROWS][LCD_COLS];
+  LcdFlushStats last = { 0, 0, 0 };
+  uint32_t totalBytes = 0;
+};
+
+template <class Lcd>
+LcdFlushStats LcdFrame::flush(Lcd& lcd) {
+  LcdFlushStats stats = { 0, 0, 0 };
+  for (uint8_t row = 0; row < LCD_ROWS; row++) {
+    // the HD44780 does not wrap to the next visual row, so the cursor is only known within a row
+    int8_t cursor = -1;
+    uint8_t start = 0;
+    uint8_t end = 0;
+    uint8_t col = 0;
+    while (col < LCD_COLS && nextRun(row, col, start, end)) {
+      if (cursor != start) {
+        lcd.setCursor(start, row);
+        stats.cursorMoves++;
+      }
+      for (uint8_t c = start; c < end; c++) {
+        lcd.write((uint8_t)cells[row][c]);
+        shown[row][c] = cells[row][c];
+      }
+      stats.chars += end - start;
+      cursor = end;
+      col = end;
+    }
+  }
+  stats.i2cBytes = (stats.chars + stats.cursorMoves) * LCD_I2C_BYTES_PER_WRITE;
+  totalBytes += stats.i2cBytes;
+  last = stats;
+  return stats;
+}
+
+#endif
@@ -10,6 +10,12 @@
 #include <ArduinoOTA.h>
 #include <ArduinoHA.h>
 #include "credentials.h" // Include credentials file
+#include "hal_esp8266.h"
+#include "controller.h"
+#include "scheduler.h"
+#include "hapublish.h"
+#include "heapstats.h"
+#include "outbox.h"
 
 // Pin Definitions
 const int inPin = 4;   // Input pin for OpenTherm
@@ -18,6 +24,32 @@ const int outPin = 5;  // Output pin for OpenTherm
 // OpenTherm object
 OpenTherm ot(inPin, outPin);
 
+// Further boilers of a cascade on their own OpenTherm adapters, build with -D CASCADE_BOILERS=2 (or 3).
+// The default pins are boot strapping pins: the adapters must not pull them the wrong way at reset.
+#ifndef CASCADE_BOILERS
+#define CASCADE_BOILERS 1
+#endif
+#ifndef CASCADE_IN_PIN_1
+#define CASCADE_IN_PIN_1 13
+#define CASCADE_OUT_PIN_1 15
+#endif
+#ifndef CASCADE_IN_PIN_2
+#define CASCADE_IN_PIN_2 0
+#define CASCADE_OUT_PIN_2 2
+#endif
+
+// Gateway mode, build with -D OT_GATEWAY: a slave adapter towards the room thermostat. It takes the
+// pins of the second boiler by default, a cascade needs other pins for it.
+#ifdef OT_GATEWAY
+#ifndef THERMOSTAT_IN_PIN
+#if CASCADE_BOILERS > 1
+#error "OT_GATEWAY with a cascade: set THERMOSTAT_IN_PIN and THERMOSTAT_OUT_PIN"
+#endif
+#define THERMOSTAT_IN_PIN 13
+#define THERMOSTAT_OUT_PIN 15
+#endif
+#endif
+
 // Wi-Fi and NTP setup
 WiFiUDP ntpUDP;
 NTPClient timeClient(ntpUDP, "de.pool.ntp.org", 0);
@@ -31,103 +63,25 @@ WiFiClient client;
 // Version information
 const char* version = "1.8.5";
 
-// Response and request IDs
-unsigned long request = 0;
-int requestID = 0;
-
-// Heating mode enumeration
-enum HeatingMode {
-  OTemp_AUTO,
-  BOOST
-};
-HeatingMode heatingMode = OTemp_AUTO;
-
-// Hot water mode enumeration
-enum HotWaterMode {
-  AUTOMATIC,
-  MANUAL
-};
-HotWaterMode hotWaterMode = AUTOMATIC;
-
-// Time of day enumeration
-enum TimeOfDay {
-  NIGHT,
-  MORNING,
-  DAY,
-  EVENING
-};
-TimeOfDay timeOfDay = EVENING;
-unsigned long lastSendTime = 0;
-float daytime = 0.0;
-float morningStart = 6.0;
-float dayStart = 10.0;
-float afternoonStart = 16.0;
-float nightStart = 21.0;
-
-// Day of the week and Legionella program day
-int dayOfWeek = 1;
-int legionellaProgramDay = 0;
-
-// Flags for enabling various functions
-bool enableHeatingProgram = true;
-bool enableHotWaterProgram = true;
-bool enableLegionellaProgram = true;
-
-bool enableCentralHeating = false;
-bool enableHotWater = false;
-bool enableCooling = false;
-
-// Flags indicating current system states
-bool isEnabledCentralHeating = false;
-bool isEnabledHotWater = false;
-bool isEnabledFlame = false;
-
-// Temperature thresholds
-float heatingThreshold = 17.0;
-float boilerTempSP = 0.0;
-float boilerTempBoost = 55.0;
-
-float dhwTemp = 0.0;
-// Hot water temperature setpoints
-float dhwTempSP = 0.0;
-float dhwTempNightSP = 20.0;
-float dhwTempMorningSP = 40.0;
-float dhwTempEveningSP = 46.0;
-float dhwTempDaySP = 35.0;
-float dhwLegionellenSP = 70.0; //the actual temperature is higher anyway
-float dhwTempBoostSP = 50.0;
-
-// Flags for forcing specific temperatures
-bool dhwForceTemp = false;
-bool heatForceTemp = false;
-
-// Temperature readings
-float outsideTemp = -4.0;
-float returnWaterTemp = 0.0;
-float boilerTemp = 0.0;
-float flowRate = 0.0;
-float exhaustTemp = 0.0;
-
-// Temperature adjustment factors
-float nightOffsetFactor = 1.0;  // No Night Offset
-float tempShiftValue = -1.5;
-
-// Temperature control parameters
-float steepness = -0.5;
-float zeroSetpoint = 43.0;
-
-// Display-related variables
-String state = "Error";
-unsigned int data = 0xFFFF;
-String wifiRSSI = " NC";
-String timeString = "";
-;
+HeapMonitor heapMonitor;
 
 // Create a Timezone object for your specific time zone
 TimeChangeRule myDST = { "DST", Last, Sun, Mar, 2, 120 };  // Daylight Saving Time rule
 TimeChangeRule mySTD = { "STD", Last, Sun, Oct, 3, 60 };   // Standard Time rule
 Timezone myTZ(myDST, mySTD);
-unsigned long lastTimeUpdate = 0;
+
+// NTP source for the time service, blocks up to 1 s so it only runs on the sync schedule
+uint32_t syncNtpTime() {
+  if (WiFi.status() != WL_CONNECTED || !timeClient.forceUpdate()) return 0;
+  return timeClient.getEpochTime();
+}
+
+int32_t localTimeOffset(uint32_t utc) {
+  return (int32_t)(myTZ.toLocal(utc) - utc);
+}
+
+// NTP sync every hour, retry every 30 s until the first one succeeded
+TimeService timeService(syncNtpTime, localTimeOffset, 3600000, 30000);
 
 // Custom characters for LCD display
 byte burningFire[8] = {
@@ -153,8 +107,26 @@ byte stoppedFire[8] = {
   B01110
 };
 
+// Cooperative scheduler driving the loop() tasks
+uint32_t schedulerClock() {
+  return millis();
+}
+Scheduler scheduler(schedulerClock);
+
+// Durations for the loop and task histograms
+uint32_t schedulerMicros() {
+  return micros();
+}
+
 HADevice device;
-HAMqtt mqtt(client, device, 22);
+HAMqtt mqtt(client, device, 57);
+
+// Hardware behind the controller, see hal.h
+OpenThermBus otBus(ot);
+LcdDisplay lcdDisplay(lcd);
+ArduinoClock arduinoClock;
+HaMqttLink mqttLink(mqtt);
+EspFlash configFlash(2 * CONFIG_SECTORS);  // configuration and schedule, 4 x 16 slots each
 
 
 HASensorNumber HAOutsideTemp("hzg-tAussen", HASensorNumber::PrecisionP2);
@@ -163,6 +135,103 @@ HASensorNumber HAReturnWaterTemp("hzg-tRuecklauf", HASensorNumber::PrecisionP2);
 HASensorNumber HAExhaustTemp("hzg-tAbgas", HASensorNumber::PrecisionP2);
 HASensorNumber HADomesticHotWaterTemp("hzg-tBrauchwasser", HASensorNumber::PrecisionP2);
 
+HASensorNumber HAHeapFree("hzg-heapFree", HASensorNumber::PrecisionP0);
+HASensorNumber HAHeapFragmentation("hzg-heapFrag", HASensorNumber::PrecisionP0);
+HASensorNumber HAHeapChangedPasses("hzg-heapChangedPasses", HASensorNumber::PrecisionP0);
+
+HASensorNumber HABurnerStartsPerHour("hzg-brennerStartsProStunde", HASensorNumber::PrecisionP0);
+
+HASensorNumber HAPredictedOutsideTemp("hzg-tAussenPrognose", HASensorNumber::PrecisionP1);
+HASensorNumber HARoomPidP("hzg-raumPidP", HASensorNumber::PrecisionP2);
+HASensorNumber HARoomPidI("hzg-raumPidI", HASensorNumber::PrecisionP2);
+HASensorNumber HARoomPidD("hzg-raumPidD", HASensorNumber::PrecisionP2);
+HASensorNumber HARelModLevel("hzg-modulation", HASensorNumber::PrecisionP0);
+HASensorNumber HACHPressure("hzg-druck", HASensorNumber::PrecisionP1);
+HASensorNumber HADHWFlowRate("hzg-wwDurchfluss", HASensorNumber::PrecisionP1);
+HASensorNumber HAFaultFlags("hzg-fehlerFlags", HASensorNumber::PrecisionP0);
+HASensorNumber HAOemFaultCode("hzg-oemFehlercode", HASensorNumber::PrecisionP0);
+HASensorNumber HABurnerStarts("hzg-brennerStarts", HASensorNumber::PrecisionP0);
+HASensorNumber HABurnerHours("hzg-brennerStunden", HASensorNumber::PrecisionP0);
+
+HASensorNumber HAOutboxDropped("hzg-outboxVerworfen", HASensorNumber::PrecisionP0);
+HASensorNumber HAOutboxHighWater("hzg-outboxMaximum", HASensorNumber::PrecisionP0);
+
+HASensorNumber HALoopP99("hzg-loopP99", HASensorNumber::PrecisionP0);
+HASensorNumber HALoopMax("hzg-loopMax", HASensorNumber::PrecisionP0);
+HASensorNumber HAOtTimeouts("hzg-otTimeouts", HASensorNumber::PrecisionP0);
+HASensorNumber HAOtInvalid("hzg-otUngueltig", HASensorNumber::PrecisionP0);
+HASensorNumber HAOtRefused("hzg-otAbgewiesen", HASensorNumber::PrecisionP0);
+HASensorNumber HAWifiRssi("hzg-wlanRssi", HASensorNumber::PrecisionP0);
+HASensorNumber HABootTime("hzg-startzeit", HASensorNumber::PrecisionP0);
+
+HASensorNumber HADhwEnergyToday("hzg-wwEnergieHeute", HASensorNumber::PrecisionP2);
+HASensorNumber HADhwEnergyYesterday("hzg-wwEnergieGestern", HASensorNumber::PrecisionP2);
+HASensorNumber HADhwChargesToday("hzg-wwLadungenHeute", HASensorNumber::PrecisionP0);
+HASensorNumber HADhwLastCharge("hzg-wwLetzteLadung", HASensorNumber::PrecisionP2);
+
+// Publish filters: deadband [K], heartbeat [ms]
+SensorPublishFilter outsideTempFilter(0.2, 300000);
+SensorPublishFilter boilerTempFilter(0.5, 300000);
+SensorPublishFilter returnWaterTempFilter(0.5, 300000);
+SensorPublishFilter exhaustTempFilter(1.0, 300000);
+SensorPublishFilter dhwTempFilter(0.5, 300000);
+SensorPublishFilter heapFreeFilter(512, 600000);
+SensorPublishFilter heapFragmentationFilter(2, 600000);
+SensorPublishFilter heapChangedPassesFilter(0, 600000);
+SensorPublishFilter burnerStartsFilter(0, 600000);
+SensorPublishFilter predictedOutsideTempFilter(0.2, 300000);
+SensorPublishFilter roomPidPFilter(0.1, 300000);
+SensorPublishFilter roomPidIFilter(0.1, 300000);
+SensorPublishFilter roomPidDFilter(0.1, 300000);
+SensorPublishFilter relModLevelFilter(5, 300000);
+SensorPublishFilter chPressureFilter(0.1, 600000);
+SensorPublishFilter dhwFlowRateFilter(0.5, 300000);
+SensorPublishFilter faultFlagsFilter(0, 600000);
+SensorPublishFilter oemFaultCodeFilter(0, 600000);
+SensorPublishFilter burnerStartsTotalFilter(0, 600000);
+SensorPublishFilter burnerHoursFilter(0, 600000);
+SensorPublishFilter outboxDroppedFilter(0, 600000);
+SensorPublishFilter outboxHighWaterFilter(0, 600000);
+SensorPublishFilter loopP99Filter(0, 600000);
+SensorPublishFilter loopMaxFilter(0, 600000);
+SensorPublishFilter otTimeoutsFilter(0, 600000);
+SensorPublishFilter otInvalidFilter(0, 600000);
+SensorPublishFilter otRefusedFilter(0, 600000);
+SensorPublishFilter wifiRssiFilter(3, 600000);
+SensorPublishFilter dhwEnergyTodayFilter(0.05, 600000);
+SensorPublishFilter dhwEnergyYesterdayFilter(0, 3600000);
+SensorPublishFilter dhwChargesTodayFilter(0, 600000);
+SensorPublishFilter dhwLastChargeFilter(0, 3600000);
+
+// Loop timing, OpenTherm counters per data ID, heap and RSSI as JSON, see formatMetrics()
+#define METRICS_TOPIC "hzg/metrics"
+char metricsBuffer[1536];
+
+// Time of each startup phase and the reset reason, retained, see formatBootTimes()
+#define BOOT_TOPIC "hzg/boot"
+bool bootReportPending = false;  // sent with the first state after each connect
+// Tasks started right away when the broker connects
+int8_t haTaskIndex = -1;
+int8_t metricsTaskIndex = -1;
+
+// Sensor changes while the broker is unreachable, sent to OUTBOX_TOPIC after the reconnect
+#define OUTBOX_TOPIC "hzg/outbox"
+enum OutboxKey : uint8_t {
+  OUTBOX_OUTSIDE,
+  OUTBOX_BOILER,
+  OUTBOX_RETURN,
+  OUTBOX_EXHAUST,
+  OUTBOX_DHW,
+  OUTBOX_BURNER_STARTS
+};
+const char* const outboxKeys[] = { "hzg-tAussen", "hzg-tVorlauf", "hzg-tRuecklauf", "hzg-tAbgas", "hzg-tBrauchwasser",
+                                   "hzg-brennerStartsProStunde" };
+MqttOutbox outbox;
+
+AvailabilityFilter hotWaterAvailability;
+AvailabilityFilter legionellaAvailability;
+AvailabilityFilter heatingAvailability;
+
 HANumber tSetDomesticHotWaterMorning("hzg-tSetWaterMorning", HANumber::PrecisionP0);
 HANumber tSetDomesticHotWaterDay("hzg-tSetWaterDay", HANumber::PrecisionP0);
 HANumber tSetDomesticHotWaterEvening("hzg-tSetWaterAfternoon", HANumber::PrecisionP0);
@@ -177,6 +246,14 @@ HASelect sAfternoonBegin("hzg-AfternoonTime");
 HASelect sNightBegin("hzg-NightTime");
 HASelect sLegionellaDay("hzg-LegionellaDay");
 
+HANumber nCurveSteepness("hzg-curveSteepness", HANumber::PrecisionP2);
+HANumber nCurveZeroSetpoint("hzg-curveZeroSetpoint", HANumber::PrecisionP1);
+HANumber nCurveShift("hzg-curveShift", HANumber::PrecisionP1);
+HANumber nBuildingTimeConstant("hzg-gebaeudeZeitkonstante", HANumber::PrecisionP1);
+HANumber nRoomSetpoint("hzg-raumSoll", HANumber::PrecisionP1);
+HANumber nDhwHysteresis("hzg-wwHysterese", HANumber::PrecisionP0);
+HASelect sCurveShape("hzg-curveShape");
+
 // devices types go here
 HASwitch boostSwitchHeating("hzg-Boost-Heizung");
 HASwitch boostSwitchHotWater("hzg-Boost-Warmwasser");
@@ -191,6 +268,7 @@ void onSetDomesticHotWaterMorningCommand(HANumeric number, HANumber* sender) {
   if (!number.isSet()) {
   } else {
     dhwTempMorningSP = number.toFloat();
+    scheduleChanged = true;
   }
   sender->setState(HANumeric(dhwTempMorningSP, 0));
 }
@@ -200,6 +278,7 @@ void onSetDomesticHotWaterDayCommand(HANumeric number, HANumber* sender) {
   if (!number.isSet()) {
   } else {
     dhwTempDaySP = number.toFloat();
+    scheduleChanged = true;
   }
   sender->setState(HANumeric(dhwTempDaySP, 0));
 }
@@ -209,6 +288,7 @@ void onSetDomesticHotWaterEveningCommand(HANumeric number, HANumber* sender) {
   if (!number.isSet()) {
   } else {
     dhwTempEveningSP = number.toFloat();
+    scheduleChanged = true;
   }
   sender->setState(HANumeric(dhwTempEveningSP, 0));
 }
@@ -218,6 +298,7 @@ void onSetDomesticHotWaterNightCommand(HANumeric number, HANumber* sender) {
   if (!number.isSet()) {
   } else {
     dhwTempNightSP = number.toFloat();
+    scheduleChanged = true;
   }
   sender->setState(HANumeric(dhwTempNightSP, 0));
 }
@@ -253,28 +334,32 @@ void onSetBoilerBoostTempCommand(HANumeric number, HANumber* sender) {
 //Callback for setting morning begin
 void onSMorningBegin(int8_t index, HASelect* sender) {
   int startHour = 4;  //Select stars at 4:00 -> When updating also update udpateHA function!
-  morningStart = (index / 2) + startHour;
-  sender->setState(round((daytime - startHour) * 2));  // report the selected option back to the HA panel
+  morningStart = index * 0.5 + startHour;  // half-hour options
+  scheduleChanged = true;
+  sender->setState(round((morningStart - startHour) * 2));  // report the selected option back to the HA panel
 }
 // Callback for setting day begin
 void onSDayBegin(int8_t index, HASelect* sender) {
   int startHour = 8;  // Select starts at 8:00 -> When updating also update udpateHA function!
-  dayStart = (index / 2) + startHour;
-  sender->setState(round((daytime - startHour) * 2));  // Report the selected option back to the HA panel
+  dayStart = index * 0.5 + startHour;  // half-hour options
+  scheduleChanged = true;
+  sender->setState(round((dayStart - startHour) * 2));  // Report the selected option back to the HA panel
 }
 
 // Callback for setting afternoon begin
 void onSAfternoonBegin(int8_t index, HASelect* sender) {
-  int startHour = 15;  // Select starts at 12:00 -> When updating also update udpateHA function!
-  afternoonStart = (index / 2) + startHour;
-  sender->setState(round((daytime - startHour) * 2));  // Report the selected option back to the HA panel
+  int startHour = 15;  // Select starts at 15:00 -> When updating also update udpateHA function!
+  afternoonStart = index * 0.5 + startHour;  // half-hour options
+  scheduleChanged = true;
+  sender->setState(round((afternoonStart - startHour) * 2));  // Report the selected option back to the HA panel
 }
 
 // Callback for setting night begin
 void onSNightBegin(int8_t index, HASelect* sender) {
-  int startHour = 18;  // Select starts at 15:00 -> When updating also update udpateHA function!
-  nightStart = (index / 2) + startHour;
-  sender->setState(round((daytime - startHour) * 2));  // Report the selected option back to the HA panel
+  int startHour = 18;  // Select starts at 18:00 -> When updating also update udpateHA function!
+  nightStart = index * 0.5 + startHour;  // half-hour options
+  scheduleChanged = true;
+  sender->setState(round((nightStart - startHour) * 2));  // Report the selected option back to the HA panel
 }
 
 // Callback for setting legionella Day
@@ -283,6 +368,55 @@ void onSLegionellaDay(int8_t index, HASelect* sender) {
   sender->setState(legionellaProgramDay);  // Report the selected option back to the HA panel
 }
 
+// Callbacks for the heating curve parameters, the table is rebuilt right away
+void onSetCurveSteepnessCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) {
+    steepness = number.toFloat();
+    rebuildHeatingCurve();
+  }
+  sender->setState(HANumeric(steepness, 2));
+}
+
+void onSetCurveZeroSetpointCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) {
+    zeroSetpoint = number.toFloat();
+    rebuildHeatingCurve();
+  }
+  sender->setState(HANumeric(zeroSetpoint, 1));
+}
+
+void onSetCurveShiftCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) {
+    tempShiftValue = number.toFloat();
+    rebuildHeatingCurve();
+  }
+  sender->setState(HANumeric(tempShiftValue, 1));
+}
+
+void onSetBuildingTimeConstantCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) buildingTimeConstant = number.toFloat();
+  sender->setState(HANumeric(buildingTimeConstant, 1));
+}
+
+void onSetDhwHysteresisCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) dhwHysteresis = number.toFloat();
+  sender->setState(HANumeric(dhwHysteresis, 0));
+}
+
+void onSetRoomSetpointCommand(HANumeric number, HANumber* sender) {
+  if (number.isSet()) {
+    roomSetpoint = number.toFloat();
+    scheduleChanged = true;
+  }
+  sender->setState(HANumeric(roomSetpoint, 1));
+}
+
+void onSCurveShape(int8_t index, HASelect* sender) {
+  curveShape = (CurveShape)index;
+  rebuildHeatingCurve();
+  sender->setState(index);
+}
+
 void onSwitchCommand(bool state, HASwitch* sender) {
   if (sender == &boostSwitchHeating) {
     heatingMode = OTemp_AUTO;
@@ -299,294 +433,406 @@ void onSwitchCommand(bool state, HASwitch* sender) {
     enableLegionellaProgram = state;
     if(!state) enableHotWaterProgram = false;
   }
-  lastSendTime = millis()-100000; //force update of all values to HA
   sender->setState(state);  // report state back to the Home Assistant
 }
 
-void processResponseCallback(unsigned long response, OpenThermResponseStatus status) {
-  unsigned long rCopy = response;
-  OpenThermMessageID rID = (OpenThermMessageID) ((rCopy >> 16) & 0xFF);  // extract only lower 8 bits
-  float oldTempBuffer = 0.0;
-  if (rID == OpenThermMessageID::Status) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      isEnabledCentralHeating = ot.isCentralHeatingActive(response);
-      isEnabledHotWater = ot.isHotWaterActive(response);
-      isEnabledFlame = ot.isFlameOn(response);
-      state = "noFlame ";
-      if (isEnabledFlame) state = "FlameOn ";
-    }
-    if (status == OpenThermResponseStatus::NONE) {
-      Serial.println("Error: OpenTherm is not initialized");
-      state = "no Init ";
-    } else if (status == OpenThermResponseStatus::INVALID) {
-      Serial.println("Error: Invalid response " + String(response, HEX));
-      state = String(response, HEX);
-    } else if (status == OpenThermResponseStatus::TIMEOUT) {
-      Serial.println("Error: Response timeout");
-      state = "Timeout ";
-    }
-  }
+// Home Assistant entities as tables, applied by applyHaDescriptors(). The unique ids stay with
+// the objects above, the library registers them at construction. Controls of a group are only
+// available while their program is switched on.
+enum HaGroup : uint8_t {
+  HA_ALWAYS,
+  HA_HOT_WATER,
+  HA_LEGIONELLA,
+  HA_HEATING
+};
 
-  //Set water temp or set boiler temp need to be send successfuly
-  if (rID == OpenThermMessageID::TdhwSet || rID == OpenThermMessageID::TSet) {
-  }
+struct HaSensorDescriptor {
+  HASensorNumber* entity;
+  const char* name;
+  const char* icon;
+  const char* unit;  // nullptr = none
+};
 
-  if (rID == OpenThermMessageID::Toutside) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      outsideTemp = (outsideTemp * 9 + ot.getFloat(response)) / 10;
-    }
-  }
+struct HaNumberDescriptor {
+  HANumber* entity;
+  const char* name;
+  const char* icon;
+  const char* unit;
+  float min;
+  float max;
+  float step;
+  HANumber::Mode mode;
+  float* value;  // published state, set by the command callback
+  HaGroup group;
+  void (*onCommand)(HANumeric number, HANumber* sender);
+};
 
-  if (rID == OpenThermMessageID::Tboiler) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      boilerTemp = ot.getFloat(response);
-    }
-  }
+struct HaSelectDescriptor {
+  HASelect* entity;
+  const char* name;
+  const char* icon;
+  const char* options;
+  HaGroup group;
+  void (*onCommand)(int8_t index, HASelect* sender);
+};
 
-  if (rID == OpenThermMessageID::Texhaust) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      exhaustTemp = ot.getFloat(response);
-    }
-  }
+struct HaSwitchDescriptor {
+  HASwitch* entity;
+  const char* name;
+  const char* icon;
+  HaGroup group;
+};
 
-  if (rID == OpenThermMessageID::Tdhw) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      dhwTemp = ot.getFloat(response);
-    }
-  }
+constexpr HaSensorDescriptor haSensors[] = {
+  // entity, name, icon, unit
+  { &HAOutsideTemp, "Außentemperatur", "mdi:thermometer", "°C" },
+  { &HABoilerTemp, "Vorlauftemperatur", "mdi:thermometer", "°C" },
+  { &HAReturnWaterTemp, "Rücklauftemperatur", "mdi:thermometer", "°C" },
+  { &HAExhaustTemp, "Abgastemperatur", "mdi:thermometer", "°C" },
+  { &HADomesticHotWaterTemp, "Warmwassertemperatur", "mdi:thermometer", "°C" },
+  { &HAHeapFree, "Heap frei (min)", "mdi:memory", "B" },
+  { &HAHeapFragmentation, "Heap Fragmentierung (max)", "mdi:memory", "%" },
+  { &HAHeapChangedPasses, "Heap Änderungen", "mdi:counter", nullptr },
+  { &HABurnerStartsPerHour, "Brennerstarts pro Stunde", "mdi:fire", "1/h" },
+  { &HAPredictedOutsideTemp, "Außentemperatur Prognose", "mdi:weather-cloudy-clock", "°C" },
+  // live terms of the room temperature trim, sum = flow temperature correction
+  { &HARoomPidP, "Raumregler P", "mdi:tune", "K" },
+  { &HARoomPidI, "Raumregler I", "mdi:tune", "K" },
+  { &HARoomPidD, "Raumregler D", "mdi:tune", "K" },
+  { &HARelModLevel, "Modulation", "mdi:fire", "%" },
+  { &HACHPressure, "Anlagendruck", "mdi:gauge", "bar" },
+  { &HADHWFlowRate, "Warmwasser Durchfluss", "mdi:water-pump", "l/min" },
+  // ASF flags, bit 0 service, 1 lockout, 2 low water pressure, 3 flame, 4 air pressure, 5 overtemperature
+  { &HAFaultFlags, "Fehlerflags", "mdi:alert", nullptr },
+  { &HAOemFaultCode, "OEM Fehlercode", "mdi:alert-circle", nullptr },
+  { &HABurnerStarts, "Brennerstarts", "mdi:counter", nullptr },
+  { &HABurnerHours, "Brennerstunden", "mdi:timer", "h" },
+  { &HAOutboxDropped, "Outbox verworfen", "mdi:tray-remove", nullptr },
+  { &HAOutboxHighWater, "Outbox Maximum", "mdi:tray-full", nullptr },
+  // loop pass duration over the uptime, bucket bounds of the histogram
+  { &HALoopP99, "Loop 99%", "mdi:timer-outline", "µs" },
+  { &HALoopMax, "Loop Maximum", "mdi:timer-alert-outline", "µs" },
+  { &HAOtTimeouts, "OpenTherm Timeouts", "mdi:timer-sand", nullptr },
+  { &HAOtInvalid, "OpenTherm ungültig", "mdi:alert-circle-outline", nullptr },
+  { &HAOtRefused, "OpenTherm abgewiesen", "mdi:cancel", nullptr },
+  { &HAWifiRssi, "WLAN Signal", "mdi:wifi", "dBm" },
+  // time from boot to the first published state
+  { &HABootTime, "Startzeit", "mdi:timer-play-outline", "ms" },
+  // heat put into the tank, from the flow/return spread while the boiler heats it
+  { &HADhwEnergyToday, "Warmwasser Energie heute", "mdi:water-boiler", "kWh" },
+  { &HADhwEnergyYesterday, "Warmwasser Energie gestern", "mdi:water-boiler", "kWh" },
+  { &HADhwChargesToday, "Warmwasser Ladungen heute", "mdi:counter", nullptr },
+  { &HADhwLastCharge, "Warmwasser letzte Ladung", "mdi:water-boiler", "kWh" },
+};
 
-  if (rID == OpenThermMessageID::Tret) {
-    if (status == OpenThermResponseStatus::SUCCESS) {
-      returnWaterTemp = ot.getFloat(response);
-    }
-  }
-}
+constexpr HaNumberDescriptor haNumbers[] = {
+  // entity, name, icon, unit, min, max, step, mode, value, group, callback
+  { &tSetDomesticHotWaterMorning, "WT Morgen", "mdi:thermometer-water", nullptr, 10, 65, 1, HANumber::ModeSlider,
+    &dhwTempMorningSP, HA_HOT_WATER, onSetDomesticHotWaterMorningCommand },
+  { &tSetDomesticHotWaterDay, "WT Tag", "mdi:thermometer-water", nullptr, 10, 65, 1, HANumber::ModeSlider,
+    &dhwTempDaySP, HA_HOT_WATER, onSetDomesticHotWaterDayCommand },
+  { &tSetDomesticHotWaterEvening, "WT Abend", "mdi:thermometer-water", nullptr, 10, 65, 1, HANumber::ModeSlider,
+    &dhwTempEveningSP, HA_HOT_WATER, onSetDomesticHotWaterEveningCommand },
+  { &tSetDomesticHotWaterNight, "WT Nacht", "mdi:thermometer-water", nullptr, 10, 65, 1, HANumber::ModeSlider,
+    &dhwTempNightSP, HA_HOT_WATER, onSetDomesticHotWaterNightCommand },
+  { &tSetDomesticHotWaterLegionella, "WT Legionellen", "mdi:thermometer-water", nullptr, 60, 75, 1,
+    HANumber::ModeSlider, &dhwLegionellenSP, HA_LEGIONELLA, onSetDomesticHotWaterLegionellaCommand },
+  { &tSetDomesticHotWaterBoost, "WT Boost", "mdi:thermometer-water", nullptr, 40, 75, 1, HANumber::ModeSlider,
+    &dhwTempBoostSP, HA_HOT_WATER, onSetDomesticHotWaterBoostCommand },
+  { &tSetBoilerBoostTemp, "Hzg Tmp Boost", "mdi:thermometer-water", nullptr, 40, 65, 1, HANumber::ModeSlider,
+    &boilerTempBoost, HA_HEATING, onSetBoilerBoostTempCommand },
+  { &nCurveSteepness, "Heizkurve Steilheit", "mdi:chart-bell-curve", nullptr, -2, 0, 0.05, HANumber::ModeBox,
+    &steepness, HA_HEATING, onSetCurveSteepnessCommand },
+  { &nCurveZeroSetpoint, "Heizkurve Vorlauf bei 0°C", "mdi:chart-bell-curve", nullptr, 20, 60, 0.5,
+    HANumber::ModeBox, &zeroSetpoint, HA_HEATING, onSetCurveZeroSetpointCommand },
+  { &nCurveShift, "Heizkurve Verschiebung", "mdi:chart-bell-curve", nullptr, -10, 10, 0.5, HANumber::ModeBox,
+    &tempShiftValue, HA_HEATING, onSetCurveShiftCommand },
+  // 0 = curve follows the measured outside temperature
+  { &nBuildingTimeConstant, "Gebäude Zeitkonstante", "mdi:home-clock", "h", 0, 24, 0.5, HANumber::ModeBox,
+    &buildingTimeConstant, HA_HEATING, onSetBuildingTimeConstantCommand },
+  // only used while a room temperature arrives on hzg/room/temperature
+  { &nRoomSetpoint, "Raum Soll", "mdi:home-thermometer", "°C", 15, 25, 0.5, HANumber::ModeBox, &roomSetpoint,
+    HA_HEATING, onSetRoomSetpointCommand },
+  // a charge starts once the tank fell this far below its setpoint
+  { &nDhwHysteresis, "WT Hysterese", "mdi:thermometer-water", "K", 2, 15, 1, HANumber::ModeSlider, &dhwHysteresis,
+    HA_HOT_WATER, onSetDhwHysteresisCommand },
+};
+
+constexpr HaSelectDescriptor haSelects[] = {
+  // entity, name, icon, options, group, callback
+  { &sMorningBegin, "Morgen ab", "mdi:weather-sunset-up", "4:00;4:30;5:00;5:30;6:00;6:30;7:00;7:30;8:00;8:30;9:00;9:30",
+    HA_HOT_WATER, onSMorningBegin },
+  { &sDayBegin, "Tag ab", "mdi:weather-sunny", "8:00;8:30;9:00;9:30;10:00;10:30;11:00;11:30;12:00;12:30", HA_HOT_WATER,
+    onSDayBegin },
+  { &sAfternoonBegin, "Abend ab", "mdi:weather-sunset-down",
+    "15:00;15:30;16:00;16:30;17:00;17:30;18:00;18:30;19:00;19:30", HA_HOT_WATER, onSAfternoonBegin },
+  { &sNightBegin, "Nacht ab", "mdi:weather-night", "18:00;18:30;19:00;19:30;20:00;20:30;21:00;21:30;22:00;22:30;23:00;23:30",
+    HA_HOT_WATER, onSNightBegin },
+  { &sLegionellaDay, "Wochentag Legionellenprogramm", "mdi:virus-off-outline",
+    "Sonntag;Montag;Dinstag;Mittwoch;Donnerstag;Freitag;Samstag", HA_LEGIONELLA, onSLegionellaDay },
+  { &sCurveShape, "Heizkurve Form", "mdi:chart-bell-curve", "Kubisch;Linear", HA_HEATING, onSCurveShape },
+};
+
+constexpr HaSwitchDescriptor haSwitches[] = {
+  // entity, name, icon, group, all use onSwitchCommand()
+  { &boostSwitchHeating, "Heizungs Booster", "mdi:radiator", HA_HEATING },
+  { &boostSwitchHotWater, "Warmwasser Booster", "mdi:water-boiler", HA_HOT_WATER },
+  { &enableHeatingProgramSwitch, "Heizung", "mdi:radiator", HA_ALWAYS },
+  { &enableHotWaterProgramSwitch, "Warmwasserbereitung", "mdi:water-boiler", HA_ALWAYS },
+  { &enableLegionellaProgramSwitch, "Legionellenprogramm", "mdi:virus-off-outline", HA_ALWAYS },
+};
 
 //void ICACHE_RAM_ATTR handleInterruptCallback() { <- Old
 void IRAM_ATTR handleInterruptCallback() {
   ot.handleInterrupt();
 }
 
-void queryDataFromTherme() {
-  //Communicate OPENTHERM
-  if (ot.isReady()) {
-    unsigned long aReq = 0;
-    if (requestID == 0) {
-      aReq = ot.buildSetBoilerStatusRequest(enableCentralHeating, enableHotWater, enableCooling);
-    }
-    if (requestID == 1) {
-      //aReq = request = ot.buildRequest(OpenThermRequestType::WRITE, OpenThermMessageID::TSet, ot.temperatureToData(boilerTempSP));
-      aReq = ot.buildRequest(OpenThermRequestType::WRITE, OpenThermMessageID::TSet, ot.temperatureToData(boilerTempSP));
-    }
-    if (requestID == 2) {
-      //aReq = request = ot.buildRequest(OpenThermRequestType::WRITE, OpenThermMessageID::TdhwSet, ot.temperatureToData(dhwTempSP));
-      aReq = ot.buildRequest(OpenThermRequestType::WRITE, OpenThermMessageID::TdhwSet, ot.temperatureToData(dhwTempSP));
-    }
-    if (requestID == 3) {
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::Toutside, data);
-    }
-    if (requestID == 4) {
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::Tboiler, data);
-    }
-    if (requestID == 5) {
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::Texhaust, data);
-    }
-    if (requestID == 6) {
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::Tdhw, data);
-    }
-    if (requestID == 7) {
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::Tret, data);
-    }
-    /*
-      if(requestID == 8){
-      aReq = ot.buildRequest(OpenThermRequestType::READ, OpenThermMessageID::BurnerStarts,data);
-      }
-    */
-    if (ot.sendRequestAync(aReq)) {
-      requestID++;
-      if (requestID == 8)
-        requestID = 0;
-    }
-  }
+void processResponseCallback(unsigned long response, OpenThermResponseStatus status) {
+  otBus.dispatch(response, status);
 }
 
+// Every adapter needs its own interrupt and response trampolines, the library takes plain functions
+#if CASCADE_BOILERS > 1
+OpenTherm ot1(CASCADE_IN_PIN_1, CASCADE_OUT_PIN_1);
+OpenThermBus otBus1(ot1);
 
-time_t getTime() {
-  timeClient.update();
-  TimeChangeRule* tcr;
-  return myTZ.toLocal(timeClient.getEpochTime(), &tcr);
-}
-
-String getTimeString(time_t currentTime) {
-  setTime(currentTime);
-  int currentHour = hour();
-  int currentMinute = minute();
-  String hourString = (currentHour < 10) ? " " + String(currentHour) : String(currentHour);
-  String minuteString = (currentMinute < 10) ? "0" + String(currentMinute) : String(currentMinute);
-  return hourString + ":" + minuteString;
-}
-
-void manageHeating() {
-  enableCentralHeating = false;
-  if (enableHeatingProgram){
-    if (heatingMode == OTemp_AUTO) {
-      if (outsideTemp < heatingThreshold) enableCentralHeating = true;
-      //boilerTempSP     = steepness * outsideTemp + zeroSetpoint; //Heizungskennlinie
-      //    y = 39.42857 - 0.7885714 -0.01828571^2 -0.001371429^3
-      //    new -0.5x-0.0005x^3+32
-      int x = outsideTemp + tempShiftValue;
-      int xx = x * x;
-      int xxx = x * x * x;
-      //boilerTempSP = 41.02857 - 0.4419048*x -0.01828571*xx -0.002438095*xxx;
-      boilerTempSP = -0.5 * x - 0.0005 * xxx + 36;
-      if (timeOfDay == 0) boilerTempSP = boilerTempSP * nightOffsetFactor;
-      //if (boilerTempSP<31 && boilerTempSP >27) boilerTempSP = 31; //Disable boiler pwm
-      //if (boilerTempSP<31 && boilerTempSP <=27) boilerTempSP = 24; //Disable boiler pwm
-    } else if (heatingMode == BOOST) {
-      enableCentralHeating = true;
-      boilerTempSP = boilerTempBoost;
-    }
-  }
+void IRAM_ATTR handleInterruptCallback1() {
+  ot1.handleInterrupt();
+}
+
+void processResponseCallback1(unsigned long response, OpenThermResponseStatus status) {
+  otBus1.dispatch(response, status);
+}
+#endif
+#if CASCADE_BOILERS > 2
+OpenTherm ot2(CASCADE_IN_PIN_2, CASCADE_OUT_PIN_2);
+OpenThermBus otBus2(ot2);
+
+void IRAM_ATTR handleInterruptCallback2() {
+  ot2.handleInterrupt();
 }
-void manageHotWater() {
-
-  if (enableHotWaterProgram && hotWaterMode == AUTOMATIC) {
-    enableHotWater = false;
-    dhwTempSP = dhwTempNightSP;
-    if (timeOfDay == MORNING) {
-      enableHotWater = true;
-      dhwTempSP = dhwTempMorningSP;
-    }
-    if (timeOfDay == DAY) {
-      enableHotWater = true;
-      dhwTempSP = dhwTempDaySP;
-    }
-    if (timeOfDay == EVENING) {
-      enableHotWater = true;
-      dhwTempSP = dhwTempEveningSP;
-    }
-    if (timeOfDay == NIGHT) {
-      enableHotWater = true;
-      dhwTempSP = dhwTempNightSP;
-    }
+
+void processResponseCallback2(unsigned long response, OpenThermResponseStatus status) {
+  otBus2.dispatch(response, status);
+}
+#endif
+
+#ifdef OT_GATEWAY
+OpenTherm otThermostat(THERMOSTAT_IN_PIN, THERMOSTAT_OUT_PIN, true);
+OpenThermSlavePort thermostatPort(otThermostat);
+
+void IRAM_ATTR handleThermostatInterrupt() {
+  otThermostat.handleInterrupt();
+}
+
+void processThermostatRequest(unsigned long request, OpenThermResponseStatus status) {
+  thermostatPort.capture(request, status);
+}
+#endif
+
+void halLog(const char* message) {
+  Serial.println(message);
+}
+
+// Shows or hides the controls of one program in Home Assistant
+void setGroupAvailability(HaGroup group, bool available) {
+  for (const HaNumberDescriptor& d : haNumbers) {
+    if (d.group == group) d.entity->setAvailability(available);
   }
-  else if (enableHotWaterProgram && hotWaterMode == MANUAL) {
-    enableHotWater = true;
-    dhwTempSP = dhwTempBoostSP;
+  for (const HaSelectDescriptor& d : haSelects) {
+    if (d.group == group) d.entity->setAvailability(available);
   }
-  
-  if (enableLegionellaProgram && dayOfWeek == legionellaProgramDay && timeOfDay==EVENING) {
-    enableHotWater = true;
-    dhwTempSP = dhwLegionellenSP;
+  for (const HaSwitchDescriptor& d : haSwitches) {
+    if (d.group == group) d.entity->setAvailability(available);
   }
 }
 
-void manageDayAndTime() {
-  if (WiFi.status() == WL_CONNECTED){
-    timeClient.update();
-    lastTimeUpdate = timeClient.getEpochTime();
+// Names, icons, units, limits and callbacks from the tables, before the first connection
+void applyHaDescriptors() {
+  for (const HaSensorDescriptor& d : haSensors) {
+    d.entity->setName(d.name);
+    d.entity->setIcon(d.icon);
+    if (d.unit) d.entity->setUnitOfMeasurement(d.unit);
   }
-  if (lastTimeUpdate > 0) {
-    dayOfWeek = timeClient.getDay();
-    timeString = getTimeString(getTime());
-    float hours = hour(getTime()) + minute(getTime()) / 60;
-    timeOfDay = NIGHT;
-    if (hours >= morningStart) timeOfDay = MORNING;
-    if (hours >= dayStart) timeOfDay = DAY;
-    if (hours >= afternoonStart) timeOfDay = EVENING;
-    if (hours >= nightStart) timeOfDay = NIGHT;
+  for (const HaNumberDescriptor& d : haNumbers) {
+    d.entity->setName(d.name);
+    d.entity->setIcon(d.icon);
+    if (d.unit) d.entity->setUnitOfMeasurement(d.unit);
+    d.entity->setMin(d.min);
+    d.entity->setMax(d.max);
+    d.entity->setStep(d.step);
+    d.entity->setMode(d.mode);
+    d.entity->onCommand(d.onCommand);
+    d.entity->setState(*d.value);
+    if (d.group != HA_ALWAYS) d.entity->setAvailability(false);
   }
-  //usefull defaults if no time is available
-  else{
-    dayOfWeek = 1;
-    timeOfDay = EVENING;
-    heatingMode = OTemp_AUTO;
-    hotWaterMode = AUTOMATIC;
+  for (const HaSelectDescriptor& d : haSelects) {
+    d.entity->setName(d.name);
+    d.entity->setIcon(d.icon);
+    d.entity->setOptions(d.options);
+    d.entity->onCommand(d.onCommand);
+    if (d.group != HA_ALWAYS) d.entity->setAvailability(false);
+  }
+  for (const HaSwitchDescriptor& d : haSwitches) {
+    d.entity->setName(d.name);
+    d.entity->setIcon(d.icon);
+    d.entity->onCommand(onSwitchCommand);
+    if (d.group != HA_ALWAYS) d.entity->setAvailability(false);
   }
+}
+
+// Everything is sent again after the broker connection was (re)established
+void onMqttConnected() {
+  outsideTempFilter.reset();
+  boilerTempFilter.reset();
+  returnWaterTempFilter.reset();
+  exhaustTempFilter.reset();
+  dhwTempFilter.reset();
+  heapFreeFilter.reset();
+  heapFragmentationFilter.reset();
+  heapChangedPassesFilter.reset();
+  burnerStartsFilter.reset();
+  predictedOutsideTempFilter.reset();
+  roomPidPFilter.reset();
+  roomPidIFilter.reset();
+  roomPidDFilter.reset();
+  relModLevelFilter.reset();
+  chPressureFilter.reset();
+  dhwFlowRateFilter.reset();
+  faultFlagsFilter.reset();
+  oemFaultCodeFilter.reset();
+  burnerStartsTotalFilter.reset();
+  burnerHoursFilter.reset();
+  outboxDroppedFilter.reset();
+  outboxHighWaterFilter.reset();
+  loopP99Filter.reset();
+  loopMaxFilter.reset();
+  otTimeoutsFilter.reset();
+  otInvalidFilter.reset();
+  otRefusedFilter.reset();
+  wifiRssiFilter.reset();
+  dhwEnergyTodayFilter.reset();
+  dhwEnergyYesterdayFilter.reset();
+  dhwChargesTodayFilter.reset();
+  dhwLastChargeFilter.reset();
+  hotWaterAvailability.reset();
+  legionellaAvailability.reset();
+  heatingAvailability.reset();
+  mqttConnected();
+
+  // ArduinoHA sends the discovery burst on connect, the state follows on the next scheduler pass
+  // instead of up to a task period later
+  uint32_t now = millis();
+  bootTimes.mark(BOOT_MQTT, now);
+  bootReportPending = true;
+  scheduler.runAt(haTaskIndex, now);
+  scheduler.runAt(metricsTaskIndex, now);
+}
+
+void onMqttMessage(const char* topic, const uint8_t* payload, uint16_t length) {
+  mqttMessage(topic, payload, length);
+}
+
+// Offline the same filters decide what goes into the outbox, deadband crossings only, the heartbeat
+// would fill it with unchanged values. onMqttConnected() resets them so the current state is
+// published right after the reconnect
+void queueOfflineChanges(uint32_t now) {
+  if (outsideTempFilter.changed(outsideTemp, now)) outbox.push(OUTBOX_OUTSIDE, outsideTemp, now);
+  if (boilerTempFilter.changed(boilerTemp, now)) outbox.push(OUTBOX_BOILER, boilerTemp, now);
+  if (returnWaterTempFilter.changed(returnWaterTemp, now)) outbox.push(OUTBOX_RETURN, returnWaterTemp, now);
+  if (exhaustTempFilter.changed(exhaustTemp, now)) outbox.push(OUTBOX_EXHAUST, exhaustTemp, now);
+  if (dhwTempFilter.changed(dhwTemp, now)) outbox.push(OUTBOX_DHW, dhwTemp, now);
+  uint32_t startsPerHour = burnerCycle.startsLastHour(now);
+  if (burnerStartsFilter.changed(startsPerHour, now)) outbox.push(OUTBOX_BURNER_STARTS, startsPerHour, now);
+}
 
+void publishBootTimes() {
+  char report[128];
+  uint16_t length = formatBootTimes(report, sizeof(report), bootTimes, ESP.getResetReason().c_str());
+  mqttLink.publish(BOOT_TOPIC, (const uint8_t*)report, length, true);
+  HABootTime.setValue(bootTimes.ms[BOOT_FIRST_PUBLISH], true);
+  Serial.println(report);
 }
 
 void updateHA() {
-  if (lastSendTime < millis() -60000) {
-
-    //update state of the switches and sensors
-    HAOutsideTemp.setValue(outsideTemp);
-    HABoilerTemp.setValue(boilerTemp);
-    HAReturnWaterTemp.setValue(returnWaterTemp);
-    HAExhaustTemp.setValue(exhaustTemp);
-    HADomesticHotWaterTemp.setValue(dhwTemp);
-    
-    tSetDomesticHotWaterMorning.setState(dhwTempMorningSP);
-    tSetDomesticHotWaterDay.setState(dhwTempDaySP);
-    tSetDomesticHotWaterEvening.setState(dhwTempEveningSP);
-    tSetDomesticHotWaterNight.setState(dhwTempNightSP);
-    tSetDomesticHotWaterLegionella.setState(dhwLegionellenSP);
-    tSetDomesticHotWaterBoost.setState(dhwTempBoostSP);
-
-    tSetBoilerBoostTemp.setState(boilerTempBoost);
-
-    int morning = round((morningStart - 4) * 2);
-    int day = round((dayStart - 8) * 2);
-    int afternoon = round((afternoonStart - 15) * 2);
-    int night = round((nightStart - 18) * 2);
-
-    sMorningBegin.setState(morning);
-    sDayBegin.setState(day);
-    sAfternoonBegin.setState(afternoon);
-    sNightBegin.setState(night);
-    sLegionellaDay.setState(legionellaProgramDay);
-
-    boostSwitchHeating.setState((bool)heatingMode);
-    boostSwitchHotWater.setState((bool)hotWaterMode);
-    enableHeatingProgramSwitch.setState(enableHeatingProgram);
-    enableHotWaterProgramSwitch.setState(enableHotWaterProgram);
-    enableLegionellaProgramSwitch.setState(enableLegionellaProgram);
-
-    //update availability of the switches
-    if(enableHotWaterProgram){
-      tSetDomesticHotWaterMorning.setAvailability(true);
-      tSetDomesticHotWaterDay.setAvailability(true);
-      tSetDomesticHotWaterEvening.setAvailability(true);
-      tSetDomesticHotWaterNight.setAvailability(true);
-      tSetDomesticHotWaterBoost.setAvailability(true);
-      sMorningBegin.setAvailability(true);
-      sDayBegin.setAvailability(true);
-      sAfternoonBegin.setAvailability(true);  
-      sNightBegin.setAvailability(true);
-      boostSwitchHotWater.setAvailability(true);
-
-    }
-    else{
-      tSetDomesticHotWaterMorning.setAvailability(false);
-      tSetDomesticHotWaterDay.setAvailability(false);
-      tSetDomesticHotWaterEvening.setAvailability(false);
-      tSetDomesticHotWaterNight.setAvailability(false);
-      tSetDomesticHotWaterBoost.setAvailability(false);
-      sMorningBegin.setAvailability(false);
-      sDayBegin.setAvailability(false);
-      sAfternoonBegin.setAvailability(false);
-      sNightBegin.setAvailability(false);
-      boostSwitchHotWater.setAvailability(false);
-    }
-    if(enableLegionellaProgram){
-      tSetDomesticHotWaterLegionella.setAvailability(true);
-      sLegionellaDay.setAvailability(true);
-    }
-    else{
-      tSetDomesticHotWaterLegionella.setAvailability(false);
-      sLegionellaDay.setAvailability(false);  
-    }
-    if(enableHeatingProgram){
-      tSetBoilerBoostTemp.setAvailability(true);
-      boostSwitchHeating.setAvailability(true);
-    }
-    else{
-      tSetBoilerBoostTemp.setAvailability(false);
-      boostSwitchHeating.setAvailability(false);
-    }
-
-
-    lastSendTime = millis();
+  unsigned long now = millis();
+  if (!mqtt.isConnected()) {
+    queueOfflineChanges(now);
+    return;
+  }
+
+  //sensors are only published when they moved past their deadband or the heartbeat ran out
+  if (outsideTempFilter.update(outsideTemp, now)) HAOutsideTemp.setValue(outsideTemp, true);
+  if (boilerTempFilter.update(boilerTemp, now)) HABoilerTemp.setValue(boilerTemp, true);
+  if (returnWaterTempFilter.update(returnWaterTemp, now)) HAReturnWaterTemp.setValue(returnWaterTemp, true);
+  if (exhaustTempFilter.update(exhaustTemp, now)) HAExhaustTemp.setValue(exhaustTemp, true);
+  if (dhwTempFilter.update(dhwTemp, now)) HADomesticHotWaterTemp.setValue(dhwTemp, true);
+  if (heapFreeFilter.update(heapMonitor.minFreeHeap, now)) HAHeapFree.setValue(heapMonitor.minFreeHeap, true);
+  if (heapFragmentationFilter.update(heapMonitor.maxFragmentation, now)) HAHeapFragmentation.setValue((uint32_t)heapMonitor.maxFragmentation, true);
+  if (heapChangedPassesFilter.update(heapMonitor.changedPasses, now)) HAHeapChangedPasses.setValue(heapMonitor.changedPasses, true);
+  uint32_t startsPerHour = burnerCycle.startsLastHour(now);
+  if (burnerStartsFilter.update(startsPerHour, now)) HABurnerStartsPerHour.setValue(startsPerHour, true);
+  if (predictedOutsideTempFilter.update(predictedOutsideTemp, now)) HAPredictedOutsideTemp.setValue(predictedOutsideTemp, true);
+  if (roomPidPFilter.update(roomPid.p, now)) HARoomPidP.setValue(roomPid.p, true);
+  if (roomPidIFilter.update(roomPid.i, now)) HARoomPidI.setValue(roomPid.i, true);
+  if (roomPidDFilter.update(roomPid.d, now)) HARoomPidD.setValue(roomPid.d, true);
+  if (relModLevelFilter.update(relModLevel, now)) HARelModLevel.setValue(relModLevel, true);
+  if (chPressureFilter.update(chPressure, now)) HACHPressure.setValue(chPressure, true);
+  if (dhwFlowRateFilter.update(flowRate, now)) HADHWFlowRate.setValue(flowRate, true);
+  if (faultFlagsFilter.update(faultFlags, now)) HAFaultFlags.setValue((uint32_t)faultFlags, true);
+  if (oemFaultCodeFilter.update(oemFaultCode, now)) HAOemFaultCode.setValue((uint32_t)oemFaultCode, true);
+  if (burnerStartsTotalFilter.update(burnerStarts, now)) HABurnerStarts.setValue(burnerStarts, true);
+  if (burnerHoursFilter.update(burnerOperationHours, now)) HABurnerHours.setValue(burnerOperationHours, true);
+  if (outboxDroppedFilter.update(outbox.dropped, now)) HAOutboxDropped.setValue(outbox.dropped, true);
+  if (outboxHighWaterFilter.update(outbox.highWater, now)) HAOutboxHighWater.setValue((uint32_t)outbox.highWater, true);
+  uint32_t loopP99 = scheduler.passHistogram().percentileUs(0.99);
+  if (loopP99Filter.update(loopP99, now)) HALoopP99.setValue(loopP99, true);
+  if (loopMaxFilter.update(scheduler.passHistogram().maxUs, now)) HALoopMax.setValue(scheduler.passHistogram().maxUs, true);
+  uint32_t otTimeouts = 0, otInvalid = 0;
+  for (uint8_t i = 0; i < otPoll.size(); i++) {
+    otTimeouts += otPoll.entry(i).timeouts;
+    otInvalid += otPoll.entry(i).invalid;
+  }
+  if (otTimeoutsFilter.update(otTimeouts, now)) HAOtTimeouts.setValue(otTimeouts, true);
+  if (otInvalidFilter.update(otInvalid, now)) HAOtInvalid.setValue(otInvalid, true);
+  if (otRefusedFilter.update(otPoll.refused, now)) HAOtRefused.setValue(otPoll.refused, true);
+  int32_t rssi = WiFi.RSSI();
+  if (wifiRssiFilter.update(rssi, now)) HAWifiRssi.setValue(rssi, true);
+  if (dhwEnergyTodayFilter.update(dhwCharge.todayKWh(), now)) HADhwEnergyToday.setValue(dhwCharge.todayKWh(), true);
+  if (dhwEnergyYesterdayFilter.update(dhwCharge.yesterdayKWh(), now)) HADhwEnergyYesterday.setValue(dhwCharge.yesterdayKWh(), true);
+  if (dhwChargesTodayFilter.update(dhwCharge.chargesToday(), now)) HADhwChargesToday.setValue(dhwCharge.chargesToday(), true);
+  if (dhwLastChargeFilter.update(dhwCharge.last().kWh, now)) HADhwLastCharge.setValue(dhwCharge.last().kWh, true);
+
+  //numbers, selects and switches only publish when their state differs from the last one sent
+  for (const HaNumberDescriptor& d : haNumbers) d.entity->setState(*d.value);
+  sCurveShape.setState((int8_t)curveShape);
+
+  int morning = round((morningStart - 4) * 2);
+  int day = round((dayStart - 8) * 2);
+  int afternoon = round((afternoonStart - 15) * 2);
+  int night = round((nightStart - 18) * 2);
+
+  sMorningBegin.setState(morning);
+  sDayBegin.setState(day);
+  sAfternoonBegin.setState(afternoon);
+  sNightBegin.setState(night);
+  sLegionellaDay.setState(legionellaProgramDay);
+
+  boostSwitchHeating.setState((bool)heatingMode);
+  boostSwitchHotWater.setState((bool)hotWaterMode);
+  enableHeatingProgramSwitch.setState(enableHeatingProgram);
+  enableHotWaterProgramSwitch.setState(enableHotWaterProgram);
+  enableLegionellaProgramSwitch.setState(enableLegionellaProgram);
+
+  //availability of the switches, only sent when it changes
+  if (hotWaterAvailability.update(enableHotWaterProgram)) setGroupAvailability(HA_HOT_WATER, enableHotWaterProgram);
+  if (legionellaAvailability.update(enableLegionellaProgram)) setGroupAvailability(HA_LEGIONELLA, enableLegionellaProgram);
+  if (heatingAvailability.update(enableHeatingProgram)) setGroupAvailability(HA_HEATING, enableHeatingProgram);
+
+  bootTimes.mark(BOOT_FIRST_PUBLISH, now);
+  if (bootReportPending) {
+    publishBootTimes();
+    bootReportPending = false;
   }
 }
 
@@ -602,73 +848,46 @@ void showSplash() {
   lcd.setCursor(0, 3);
   lcd.print("v. ");
   lcd.print(version);
-  delay(1000);
-  lcd.clear();
+  // stays up until the lcd task's first run redraws the whole display
+  frame.invalidate();
 }
 
-void showMain() {
-  String ipStr = "not connected";
-  if(WiFi.status() == WL_CONNECTED){
-  ipStr =WiFi.localIP().toString();
+void serviceNetwork() {
+  if (WiFi.status() == WL_CONNECTED) {
+    bootTimes.mark(BOOT_WIFI, millis());
+    mqtt.loop();
   }
-  //lcd.clear();
-  //1st row
-  lcd.setCursor(0, 0);
-  lcd.print(ipStr);
-
-  lcd.setCursor(17, 0);
-  lcd.print(wifiRSSI);
-
-  //2nd row
-  lcd.setCursor(0, 1);
-  lcd.print(state);
+}
 
-  lcd.setCursor(8, 1);
+// One batch per run keeps the backlog from flooding the broker after a reconnect
+void flushOutbox() {
+  outbox.flush(mqttLink, OUTBOX_TOPIC, outboxKeys, millis(), timeService.isSynced() ? timeService.utc() : 0);
+}
 
-  if (isEnabledCentralHeating) lcd.print("CH On");
-  else lcd.print("     ");
-  lcd.setCursor(14, 1);
-  if (isEnabledHotWater) lcd.print("HW On");
-  else lcd.print("     ");
+void publishMetrics() {
+  if (!mqtt.isConnected()) return;
+  SystemMetrics system = { (uint32_t)(millis() / 1000), ESP.getFreeHeap(), heapMonitor.minFreeHeap, (int16_t)WiFi.RSSI() };
+  uint16_t length = formatMetrics(metricsBuffer, sizeof(metricsBuffer), system, scheduler, otPoll, otBus.frames,
+                                  otGateway);
+  mqttLink.publish(METRICS_TOPIC, (const uint8_t*)metricsBuffer, length, false);
+}
 
-  //if (isEnabledCentralHeating) lcd.write((uint8_t)0);  // Display the burning fire symbol
-  //else lcd.write((uint8_t)1);                          // Display the stopped burning fire symbol
+void sampleHeapFragmentation() {
+  heapMonitor.sampleFragmentation(ESP.getHeapFragmentation(), ESP.getMaxFreeBlockSize());
+}
 
-  //3rd row - col, row
-  lcd.setCursor(0, 2);
-  lcd.print("SP");
-  lcd.setCursor(2, 2);
-  lcd.print(String(boilerTempSP, 0));
-  lcd.setCursor(5, 2);
-  lcd.print("BO");
-  lcd.setCursor(7, 2);
-  lcd.print(String(boilerTemp, 0));
-  lcd.setCursor(10, 2);
-  lcd.print("RW");
-  lcd.setCursor(12, 2);
-  lcd.print(String(returnWaterTemp, 0));
-  lcd.setCursor(15, 2);
-  lcd.print("EX");
-  lcd.setCursor(17, 2);
-  lcd.print(String(exhaustTemp, 0));
-
-  //4th row
-  lcd.setCursor(0, 3);
-  lcd.print("SP");
-  lcd.setCursor(2, 3);
-  lcd.print(String(dhwTempSP, 0));
-  lcd.setCursor(5, 3);
-  lcd.print("WT");
-  lcd.setCursor(7, 3);
-  lcd.print(String(dhwTemp, 0));
-  lcd.setCursor(10, 3);
-  lcd.print("OT");
-  lcd.print("    ");
-  lcd.setCursor(12, 3);
-  lcd.print(String(outsideTemp, 0));
-  lcd.setCursor(15, 3);
-  lcd.print(timeString);
-  delay(150);
+void setupTasks() {
+  // name, callback, period [ms], deadline [ms]
+  scheduler.addTask("ota", []() { ArduinoOTA.handle(); }, 0, 50);
+  addControllerTasks(scheduler);
+  scheduler.addTask("network", serviceNetwork, 10, 200);
+  haTaskIndex = scheduler.addTask("homeAssistant", updateHA, 1000, 200);
+  scheduler.addTask("outbox", flushOutbox, 250, 100);
+  scheduler.addTask("heap", sampleHeapFragmentation, 10000, 20);
+  metricsTaskIndex = scheduler.addTask("metrics", publishMetrics, 60000, 100);
+  scheduler.setMicrosClock(schedulerMicros);
+  // the splash stays for a second without blocking the bus and the network
+  scheduler.runAt(scheduler.find("lcd"), millis() + 1000);
 }
 
 void setup() {
@@ -707,6 +926,7 @@ void setup() {
   });
 */
   ArduinoOTA.begin();
+  timeClient.begin();
 
   byte mac[WL_MAC_ADDR_LENGTH];
   WiFi.macAddress(mac);
@@ -721,9 +941,32 @@ void setup() {
   lcd.createChar(0, burningFire);
   lcd.createChar(1, stoppedFire);
 
+  hal = { &otBus, &lcdDisplay, &arduinoClock, &mqttLink, &configFlash, { nullptr, nullptr }, nullptr };
+#if CASCADE_BOILERS > 1
+  hal.extraBus[0] = &otBus1;
+#endif
+#if CASCADE_BOILERS > 2
+  hal.extraBus[1] = &otBus2;
+#endif
+#ifdef OT_GATEWAY
+  hal.thermostat = &thermostatPort;
+#endif
+  setupController();
   ot.begin(handleInterruptCallback, processResponseCallback);
+#if CASCADE_BOILERS > 1
+  ot1.begin(handleInterruptCallback1, processResponseCallback1);
+#endif
+#if CASCADE_BOILERS > 2
+  ot2.begin(handleInterruptCallback2, processResponseCallback2);
+#endif
+#ifdef OT_GATEWAY
+  otThermostat.begin(handleThermostatInterrupt, processThermostatRequest);
+#endif
   showSplash();
 
+  mqtt.onConnected(onMqttConnected);
+  mqtt.onMessage(onMqttMessage);
+  mqtt.setBufferSize(1024);  // a full week schedule arrives in one message
   mqtt.begin(mqttServer);
 
   // set device's details (optional)
@@ -732,182 +975,12 @@ void setup() {
   device.setModel(hostname);
   device.setManufacturer("Thomas");
 
-  // HANumber tSetDomesticHotWaterMorning - Morgensonne erwacht ☀️
-  tSetDomesticHotWaterMorning.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterMorning.setName("WT Morgen");
-  tSetDomesticHotWaterMorning.onCommand(onSetDomesticHotWaterMorningCommand);
-  tSetDomesticHotWaterMorning.setMin(10);  // Mindesttemperatur, um den Tag zu beginnen!
-  tSetDomesticHotWaterMorning.setMax(65);  // Maximale Temperatur, weil es heiß wird!
-  tSetDomesticHotWaterMorning.setStep(1);  // In 5-Grad-Schritten aufwärmen!
-  tSetDomesticHotWaterMorning.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterMorning.setState(HANumeric(dhwTempMorningSP, 1));  // Aktuelle Stimmung: Toasty 🌡️
-  tSetDomesticHotWaterMorning.setAvailability(false);
-
-  // HANumber tSetDomesticHotWaterDay - Nachmittagskühle vertreiben 🌤️
-  tSetDomesticHotWaterDay.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterDay.setName("WT Tag");
-  tSetDomesticHotWaterDay.onCommand(onSetDomesticHotWaterDayCommand);
-  tSetDomesticHotWaterDay.setMin(10);  // Mindesttemperatur, um es warm zu halten!
-  tSetDomesticHotWaterDay.setMax(65);  // Maximale Temperatur, um die Hitze zu steigern!
-  tSetDomesticHotWaterDay.setStep(1);  // In 5-Grad-Schritten brutzeln!
-  tSetDomesticHotWaterDay.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterDay.setState(HANumeric(dhwTempDaySP, 1));  // Aktuelle Stimmung: Gemütlich 🔥
-  tSetDomesticHotWaterDay.setAvailability(false);
-
-  // HANumber tSetDomesticHotWaterEvening - Abendglanz erwärmen 🌇
-  tSetDomesticHotWaterEvening.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterEvening.setName("WT Abend");
-  tSetDomesticHotWaterEvening.onCommand(onSetDomesticHotWaterEveningCommand);
-  tSetDomesticHotWaterEvening.setMin(10);  // Mindesttemperatur, weil es kühl wird!
-  tSetDomesticHotWaterEvening.setMax(65);  // Maximale Temperatur, um den Abend anzufeuern!
-  tSetDomesticHotWaterEvening.setStep(1);  // Sanft in 5-Grad-Schritten aufsteigen!
-  tSetDomesticHotWaterEvening.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterEvening.setState(HANumeric(dhwTempEveningSP, 1));  // Aktuelle Wärme: Einladend 🌅
-  tSetDomesticHotWaterEvening.setAvailability(false);
-
-  // HANumber tSetDomesticHotWaterNight - Nachtstille genießen 🌙
-  tSetDomesticHotWaterNight.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterNight.setName("WT Nacht");
-  tSetDomesticHotWaterNight.onCommand(onSetDomesticHotWaterNightCommand);
-  tSetDomesticHotWaterNight.setMin(10);  // Mindesttemperatur, um die Nacht zu überstehen!
-  tSetDomesticHotWaterNight.setMax(65);  // Maximale Temperatur, um die Kälte zu vertreiben!
-  tSetDomesticHotWaterNight.setStep(1);  // In 5-Grad-Schritten abkühlen!
-  tSetDomesticHotWaterNight.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterNight.setState(HANumeric(dhwTempNightSP, 1));  // Aktuelle Stimmung: Kuschelig 🌌
-  tSetDomesticHotWaterNight.setAvailability(false);
-  
-  // HANumber tSetDomesticHotWaterLegionella - Legionellenabwehr im Superheldenstil 🦸
-  tSetDomesticHotWaterLegionella.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterLegionella.setName("WT Legionellen");
-  tSetDomesticHotWaterLegionella.onCommand(onSetDomesticHotWaterLegionellaCommand);
-  tSetDomesticHotWaterLegionella.setMin(60);  // Mindesttemperatur, um diese fiesen Keime fernzuhalten!
-  tSetDomesticHotWaterLegionella.setMax(75);  // Maximale Temperatur, weil wir Superhelden-heiß sind!
-  tSetDomesticHotWaterLegionella.setStep(1);  // In 5-Grad-Schritten in Aktion treten!
-  tSetDomesticHotWaterLegionella.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterLegionella.setState(HANumeric(dhwLegionellenSP, 1));  // Legionellenabwehrlevel: Superheld 💪
-  tSetDomesticHotWaterLegionella.setAvailability(false);
-
-
-  tSetDomesticHotWaterBoost.setIcon("mdi:thermometer-water");
-  tSetDomesticHotWaterBoost.setName("WT Boost");
-  tSetDomesticHotWaterBoost.onCommand(onSetDomesticHotWaterBoostCommand);
-  tSetDomesticHotWaterBoost.setMin(40);
-  tSetDomesticHotWaterBoost.setMax(75);
-  tSetDomesticHotWaterBoost.setStep(1);
-  tSetDomesticHotWaterBoost.setMode(HANumber::ModeSlider);
-  tSetDomesticHotWaterBoost.setState(HANumeric(dhwTempBoostSP, 1));
-  tSetDomesticHotWaterBoost.setAvailability(false);
-
-  // HANumber tSetBoilerBoostTemp - Boiler Boost Temperature
-  tSetBoilerBoostTemp.setIcon("mdi:thermometer-water");
-  tSetBoilerBoostTemp.setName("Hzg Tmp Boost");
-  tSetBoilerBoostTemp.onCommand(onSetBoilerBoostTempCommand);
-  tSetBoilerBoostTemp.setMin(40);
-  tSetBoilerBoostTemp.setMax(65);
-  tSetBoilerBoostTemp.setStep(1);
-  tSetBoilerBoostTemp.setMode(HANumber::ModeSlider);
-  tSetBoilerBoostTemp.setState(HANumeric(boilerTempBoost, 1));
-  tSetBoilerBoostTemp.setAvailability(false);
-
-
-  // HASensorNumber HAOutsideTemp - Außentemperatur, das Wetter vor der Haustür ☀️
-  HAOutsideTemp.setUnitOfMeasurement("°C");
-  HAOutsideTemp.setIcon("mdi:thermometer");
-  HAOutsideTemp.setName("Außentemperatur");
-
-  // HASensorNumber HABoilerTemp - Vorlauftemperatur, wenn es heiß wird 🌡️
-  HABoilerTemp.setUnitOfMeasurement("°C");
-  HABoilerTemp.setIcon("mdi:thermometer");
-  HABoilerTemp.setName("Vorlauftemperatur");
-
-  // HASensorNumber HAReturnWaterTemp - Rücklauftemperatur, wenn die Wärme zurückkommt 🔥
-  HAReturnWaterTemp.setUnitOfMeasurement("°C");
-  HAReturnWaterTemp.setIcon("mdi:thermometer");
-  HAReturnWaterTemp.setName("Rücklauftemperatur");
-
-  // HASensorNumber HAExhaustTemp - Abgastemperatur, wenn der Rauch aufsteigt 🌬️
-  HAExhaustTemp.setUnitOfMeasurement("°C");
-  HAExhaustTemp.setIcon("mdi:thermometer");
-  HAExhaustTemp.setName("Abgastemperatur");
-
-  // HASensorNumber HADomesticHotWaterTemp - Warmwassertemperatur, wenn du es warm magst 🔥
-  HADomesticHotWaterTemp.setUnitOfMeasurement("°C");
-  HADomesticHotWaterTemp.setIcon("mdi:thermometer");
-  HADomesticHotWaterTemp.setName("Warmwassertemperatur");
-
-  // set available options
-  sMorningBegin.setOptions("4:00;4:30;5:00;5:30;6:00;6:30;7:00;7:30;8:00;8:30;9:00;9:30");
-  sMorningBegin.onCommand(onSMorningBegin);
-  sMorningBegin.setIcon("mdi:weather-sunset-up");
-  sMorningBegin.setName("Morgen ab");
-  sMorningBegin.setAvailability(false);
-
-  // set available options
-  sDayBegin.setOptions("8:00;8:30;9:00;9:30;10:00;10:30;11:00;11:30;12:00;12:30");
-  sDayBegin.onCommand(onSDayBegin);
-  sDayBegin.setIcon("mdi:weather-sunny");
-  sDayBegin.setName("Tag ab");
-  sDayBegin.setAvailability(false);
-
-  // set available options
-  sAfternoonBegin.setOptions("15:00;15:30;16:00;16:30;17:00;17:30;18:00;18:30;19:00;19:30");
-  sAfternoonBegin.onCommand(onSAfternoonBegin);
-  sAfternoonBegin.setIcon("mdi:weather-sunset-down");
-  sAfternoonBegin.setName("Abend ab");
-  sAfternoonBegin.setAvailability(false);
-
-  // set available options
-  sNightBegin.setOptions("18:00;18:30;19:00;19:30;20:00;20:30;21:00;21:30;22:00;22:30;23:00;23:30");
-  sNightBegin.onCommand(onSNightBegin);
-  sNightBegin.setIcon("mdi:weather-night");
-  sNightBegin.setName("Nacht ab");
-  sNightBegin.setAvailability(false);
-
-  sLegionellaDay.setOptions("Sonntag;Montag;Dinstag;Mittwoch;Donnerstag;Freitag;Samstag");
-  sLegionellaDay.onCommand(onSLegionellaDay);
-  sLegionellaDay.setIcon("mdi:virus-off-outline");
-  sLegionellaDay.setName("Wochentag Legionellenprogramm");
-  sLegionellaDay.setAvailability(false);
-
-  boostSwitchHeating.setName("Heizungs Booster");
-  boostSwitchHeating.setIcon("mdi:radiator");
-  boostSwitchHeating.onCommand(onSwitchCommand);
-  boostSwitchHeating.setAvailability(false);
-
-  boostSwitchHotWater.setName("Warmwasser Booster");
-  boostSwitchHotWater.setIcon("mdi:water-boiler");
-  boostSwitchHotWater.onCommand(onSwitchCommand);
-  boostSwitchHotWater.setAvailability(false);
-
-  enableHeatingProgramSwitch.setName("Heizung");
-  enableHeatingProgramSwitch.setIcon("mdi:radiator");
-  enableHeatingProgramSwitch.onCommand(onSwitchCommand);
-
-  enableHotWaterProgramSwitch.setName("Warmwasserbereitung");
-  enableHotWaterProgramSwitch.setIcon("mdi:water-boiler");
-  enableHotWaterProgramSwitch.onCommand(onSwitchCommand);
-
-  enableLegionellaProgramSwitch.setName("Legionellenprogramm");
-  enableLegionellaProgramSwitch.setIcon("mdi:virus-off-outline");
-  enableLegionellaProgramSwitch.onCommand(onSwitchCommand);
+  applyHaDescriptors();
+
+  setupTasks();
 }
 
 void loop() {
-
-  ArduinoOTA.handle();
-
-  ot.process();
-  queryDataFromTherme();
-  manageHeating();
-  manageHotWater();
-  manageDayAndTime();
-
-  if (WiFi.status() == WL_CONNECTED) {
-    wifiRSSI = String(WiFi.RSSI());
-    mqtt.loop();
-    updateHA();
-  } else {
-    wifiRSSI = " NC";
-  }
-  showMain();
-}
\ No newline at end of file
+  scheduler.run();
+  heapMonitor.samplePass(ESP.getFreeHeap());
+}
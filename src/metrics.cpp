@@ -0,0 +1,207 @@
+// metrics.cpp
+
+#include <string.h>
+#include "metrics.h"
+#include "fixedstring.h"
+#include "scheduler.h"
+#include "otpoll.h"
+#include "otqueue.h"
+#include "otgateway.h"
+
+static const uint32_t bucketLimits[LATENCY_BUCKETS - 1] = { 100, 300, 1000, 3000, 10000, 30000, 100000 };
+
+void LatencyHistogram::clear() {
+  memset(counts, 0, sizeof(counts));
+  maxUs = 0;
+}
+
+void LatencyHistogram::add(uint32_t us) {
+  uint8_t b = 0;
+  while (b < LATENCY_BUCKETS - 1 && us > bucketLimits[b]) b++;
+  counts[b]++;
+  if (us > maxUs) maxUs = us;
+}
+
+uint32_t LatencyHistogram::total() const {
+  uint32_t n = 0;
+  for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) n += counts[b];
+  return n;
+}
+
+uint32_t LatencyHistogram::bucketLimitUs(uint8_t bucket) {
+  return bucket < LATENCY_BUCKETS - 1 ? bucketLimits[bucket] : UINT32_MAX;
+}
+
+uint32_t LatencyHistogram::percentileUs(float fraction) const {
+  uint32_t n = total();
+  if (n == 0) return 0;
+  uint32_t rank = (uint32_t)(fraction * n + 0.5);
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+    seen += counts[b];
+    if (seen >= rank) return bucketLimits[b] < maxUs ? bucketLimits[b] : maxUs;
+  }
+  return maxUs;
+}
+
+#define JSON_MAX_DEPTH 4
+
+// Appends to a caller provided buffer and keeps room for the closing brackets of everything
+// opened. An element that does not fit is taken back from its mark and everything after it
+// is dropped, finish() closes what is open: a report cut short is still valid JSON.
+struct JsonOut {
+  struct Mark {
+    uint16_t len;
+    uint8_t depth;
+  };
+
+  JsonOut(char* out, uint16_t size) : out(out), size(size) { out[0] = '\0'; }
+
+  JsonOut& text(const char* s) { return put(s, depth); }
+  JsonOut& number(int32_t value) {
+    char digits[12];
+    formatInt(digits, sizeof(digits), value);
+    return text(digits);
+  }
+  // counters, all of them unsigned, would turn negative past 2^31 as int32_t
+  JsonOut& number(uint32_t value) {
+    char digits[11];
+    formatUint(digits, sizeof(digits), value);
+    return text(digits);
+  }
+  JsonOut& key(const char* name) { return text("\"").text(name).text("\":"); }
+  JsonOut& key(int32_t id) { return text("\"").number(id).text("\":"); }
+  // '{' or '['
+  JsonOut& open(char bracket) {
+    const char s[2] = { bracket, '\0' };
+    if (depth >= JSON_MAX_DEPTH) full = true;
+    put(s, depth + 1);
+    if (!full) closers[depth++] = bracket == '{' ? '}' : ']';
+    return *this;
+  }
+  JsonOut& close() {
+    if (full || depth == 0) return *this;
+    const char s[2] = { closers[--depth], '\0' };
+    return put(s, depth);
+  }
+
+  Mark mark() const { return { len, depth }; }
+  // False if the element since the mark did not fit, it is removed again
+  bool keep(const Mark& m) {
+    if (!full) return true;
+    len = m.len;
+    depth = m.depth;
+    out[len] = '\0';
+    return false;
+  }
+  uint16_t finish() {
+    while (depth) out[len++] = closers[--depth];
+    out[len] = '\0';
+    return len;
+  }
+
+  bool full = false;
+
+private:
+  JsonOut& put(const char* s, uint8_t reserve) {
+    if (full) return *this;
+    while (*s) {
+      if (len + reserve + 1 >= size) {
+        full = true;
+        break;
+      }
+      out[len++] = *s++;
+    }
+    out[len] = '\0';
+    return *this;
+  }
+
+  char* out;
+  uint16_t size;
+  uint16_t len = 0;
+  uint8_t depth = 0;
+  char closers[JSON_MAX_DEPTH];
+};
+
+bool BootTimes::complete() const {
+  for (uint8_t i = 0; i < BOOT_PHASES; i++) {
+    if (ms[i] == 0) return false;
+  }
+  return true;
+}
+
+uint16_t formatBootTimes(char* out, uint16_t size, const BootTimes& boot, const char* resetReason) {
+  static const char* const keys[BOOT_PHASES] = { "ot", "wifi", "mqtt", "publish" };
+  if (size == 0) return 0;
+  JsonOut json(out, size);
+  json.text("{").key("reset").text("\"").text(resetReason).text("\"");
+  for (uint8_t i = 0; i < BOOT_PHASES; i++) json.text(",").key(keys[i]).number(boot.ms[i]);
+  json.text("}");
+  return json.finish();
+}
+
+uint16_t formatMetrics(char* out, uint16_t size, const SystemMetrics& system, const Scheduler& scheduler,
+                       const OtPollScheduler& poll, const OtFrameQueue& queue, const OtGateway& gateway) {
+  if (size < 3) {
+    if (size) out[0] = '\0';
+    return 0;
+  }
+  JsonOut json(out, size);
+  JsonOut::Mark m;
+  json.open('{');
+  m = json.mark();
+  json.key("up").number(system.uptimeS);
+  json.text(",").key("heap").number(system.freeHeap);
+  json.text(",").key("heapMin").number(system.minFreeHeap);
+  json.text(",").key("rssi").number((int32_t)system.rssi);
+  if (!json.keep(m)) return json.finish();
+
+  const LatencyHistogram& loop = scheduler.passHistogram();
+  m = json.mark();
+  json.text(",").key("loop").open('{').key("n").number(scheduler.passes());
+  json.text(",").key("p50").number(loop.percentileUs(0.5));
+  json.text(",").key("p99").number(loop.percentileUs(0.99));
+  json.text(",").key("max").number(loop.maxUs);
+  json.text(",").key("h").open('[');
+  for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) json.text(b ? "," : "").number(loop.counts[b]);
+  json.close().close();
+  if (!json.keep(m)) return json.finish();
+
+  m = json.mark();
+  json.text(",").key("tasks").open('{');
+  if (!json.keep(m)) return json.finish();
+  for (uint8_t i = 0; i < scheduler.taskCount(); i++) {
+    const Task& t = scheduler.task(i);
+    m = json.mark();
+    json.text(i ? "," : "").key(t.name).open('[').number(t.histogram.percentileUs(0.5));
+    json.text(",").number(t.histogram.percentileUs(0.99)).text(",").number(t.histogram.maxUs);
+    json.text(",").number(t.overruns).close();
+    if (!json.keep(m)) return json.finish();
+  }
+  json.close();
+
+  m = json.mark();
+  json.text(",").key("ot").open('{').key("refused").number(poll.refused);
+  json.text(",").key("queue").open('[').number(queue.pushed).text(",").number(queue.dropped);
+  json.text(",").number((uint32_t)queue.highWater).close();
+  if (!json.keep(m)) return json.finish();
+  if (gateway.active()) {
+    m = json.mark();
+    json.text(",").key("gateway").open('{').key("forwarded").number(gateway.forwarded);
+    json.text(",").key("overrides").number(gateway.overrides);
+    json.text(",").key("answered").number(gateway.answered);
+    json.text(",").key("unanswered").number(gateway.unanswered);
+    json.text(",").key("late").number(gateway.late);
+    json.text(",").key("invalid").number(gateway.invalid).close();
+    if (!json.keep(m)) return json.finish();
+  }
+  for (uint8_t i = 0; i < poll.size(); i++) {
+    const PollEntry& e = poll.entry(i);
+    m = json.mark();
+    json.text(",").key(e.id).open('[').number(e.successes).text(",").number(e.timeouts);
+    json.text(",").number(e.invalid).close();
+    if (!json.keep(m)) return json.finish();
+  }
+  json.close().close();
+  return json.finish();
+}
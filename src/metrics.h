@@ -0,0 +1,73 @@
+// metrics.h
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Fixed buckets, upper bounds 100 us, 300 us, 1 ms, 3 ms, 10 ms, 30 ms, 100 ms and above
+#define LATENCY_BUCKETS 8
+
+// Latency distribution without allocations, counts since boot
+struct LatencyHistogram {
+  uint32_t counts[LATENCY_BUCKETS];
+  uint32_t maxUs;
+
+  void clear();
+  void add(uint32_t us);
+  uint32_t total() const;
+  // Upper bound of the bucket the given fraction of samples falls into (maxUs for the last bucket)
+  uint32_t percentileUs(float fraction) const;
+  static uint32_t bucketLimitUs(uint8_t bucket);
+};
+
+// Startup phases, in the order they normally complete after a reboot
+enum BootPhase : uint8_t {
+  BOOT_OT_RESPONSE,    // first valid OpenTherm response
+  BOOT_WIFI,           // associated
+  BOOT_MQTT,           // broker connected, discovery sent
+  BOOT_FIRST_PUBLISH,  // state published, the controller is operational
+  BOOT_PHASES
+};
+
+// millis() at each startup phase, 0 = not reached yet
+struct BootTimes {
+  uint32_t ms[BOOT_PHASES];
+
+  void mark(BootPhase phase, uint32_t now) {
+    if (ms[phase] == 0) ms[phase] = now ? now : 1;
+  }
+  bool complete() const;
+};
+
+// {"reset":"<reason>","ot":<ms>,"wifi":<ms>,"mqtt":<ms>,"publish":<ms>}, 0 for a phase not reached.
+// Returns the length, the report is cut at size - 1 characters.
+uint16_t formatBootTimes(char* out, uint16_t size, const BootTimes& boot, const char* resetReason);
+
+class Scheduler;
+class OtPollScheduler;
+class OtFrameQueue;
+class OtGateway;
+
+// Platform figures of the metrics report
+struct SystemMetrics {
+  uint32_t uptimeS;
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  int16_t rssi;  // 0 = not connected
+};
+
+// JSON report of the loop and task timing and the OpenTherm counters per data ID:
+// {"up":<s>,"heap":<B>,"heapMin":<B>,"rssi":<dBm>,
+//  "loop":{"n":<passes>,"p50":<us>,"p99":<us>,"max":<us>,"h":[<bucket counts>]},
+//  "tasks":{"<name>":[<p50 us>,<p99 us>,<max us>,<overruns>],...},
+//  "ot":{"refused":<n>,"queue":[<frames>,<dropped>,<high-water>],
+//        "gateway":{"forwarded":<n>,"overrides":<n>,"answered":<n>,"unanswered":<n>,"late":<n>,"invalid":<n>},
+//        "<id>":[<ok>,<timeouts>,<invalid>],...}}
+// "gateway" only in gateway mode, where the thermostat's requests replace the poll table.
+// Returns the length. A task or data ID that does not fit is left out together with everything
+// after it, the open objects are closed, so a short buffer still gives valid JSON.
+uint16_t formatMetrics(char* out, uint16_t size, const SystemMetrics& system, const Scheduler& scheduler,
+                       const OtPollScheduler& poll, const OtFrameQueue& queue, const OtGateway& gateway);
+
+#endif
@@ -0,0 +1,55 @@
+// optimalstart.cpp
+
+#include "optimalstart.h"
+
+// Smallest rise that starts a measurement, and how close the value has to get to the target
+static const float minRise[OPTSTART_KINDS] = { 3.0, 0.5 };
+static const float tolerance[OPTSTART_KINDS] = { 1.0, 0.2 };
+// Until something is learned: 1.5 min/K for the tank, 40 min/K for the rooms
+static const uint16_t defaultRate[OPTSTART_KINDS] = { 15, 400 };
+
+OptimalStart::OptimalStart() {
+  for (uint8_t k = 0; k < OPTSTART_KINDS; k++) {
+    for (uint8_t b = 0; b < OPTSTART_BUCKETS; b++) table.rate[k][b] = defaultRate[k];
+    heatUp[k].active = false;
+    lastTarget[k] = 0.0;
+  }
+}
+
+uint8_t OptimalStart::bucket(float outside) {
+  int16_t b = (outside - OPTSTART_BUCKET_MIN) / OPTSTART_BUCKET_WIDTH + 1;
+  if (outside < OPTSTART_BUCKET_MIN) b = 0;
+  if (b >= OPTSTART_BUCKETS) b = OPTSTART_BUCKETS - 1;
+  return b;
+}
+
+float OptimalStart::leadMinutes(OptimalStartKind kind, float outside, float value, float target) const {
+  if (target <= value) return 0.0;
+  float minutes = table.rate[kind][bucket(outside)] / 10.0 * (target - value);
+  return minutes < OPTSTART_MAX_LEAD_MIN ? minutes : OPTSTART_MAX_LEAD_MIN;
+}
+
+void OptimalStart::track(OptimalStartKind kind, uint32_t now, float outside, float value, float target) {
+  HeatUp& h = heatUp[kind];
+  bool risen = target > lastTarget[kind];
+  bool changed = target != lastTarget[kind];
+  lastTarget[kind] = target;
+
+  if (h.active && (changed || now - h.startMs > OPTSTART_TIMEOUT_MS)) h.active = false;
+  if (!h.active && risen && target - value >= minRise[kind]) {
+    h.active = true;
+    h.startMs = now;
+    h.startValue = value;
+    h.target = target;
+    h.bucket = bucket(outside);
+    return;
+  }
+  if (!h.active || value < h.target - tolerance[kind]) return;
+
+  h.active = false;
+  float measured = (now - h.startMs) / 6000.0 / (h.target - h.startValue);  // 1/10 min per K
+  uint16_t& rate = table.rate[kind][h.bucket];
+  float updated = rate + OPTSTART_LEARN_WEIGHT * (measured - rate);
+  rate = updated < 1 ? 1 : (updated > 65535 ? 65535 : (uint16_t)(updated + 0.5));
+  learned++;
+}
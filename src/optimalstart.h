@@ -0,0 +1,61 @@
+// optimalstart.h
+
+#ifndef OPTIMALSTART_H
+#define OPTIMALSTART_H
+
+#include <stdint.h>
+
+// What is heated up: the DHW tank or the rooms
+enum OptimalStartKind : uint8_t {
+  OPTSTART_DHW,
+  OPTSTART_HEATING,
+  OPTSTART_KINDS
+};
+
+// Outside temperature buckets of the learned table: below -15, -15..-10, ..., 15 and above
+#define OPTSTART_BUCKETS 8
+#define OPTSTART_BUCKET_MIN -15
+#define OPTSTART_BUCKET_WIDTH 5
+// A period is brought forward by at most this much
+#define OPTSTART_MAX_LEAD_MIN 180
+// Heat-ups that take longer are not learned
+#define OPTSTART_TIMEOUT_MS (4UL * 3600000)
+// Weight of a new measurement in the learned rate
+#define OPTSTART_LEARN_WEIGHT 0.3
+
+// Learned heat-up rates in 1/10 minute per kelvin, per kind and outside temperature bucket
+struct OptimalStartTable {
+  uint16_t rate[OPTSTART_KINDS][OPTSTART_BUCKETS];
+};
+
+// Learns how long a heat-up takes at a given outside temperature and predicts how early a
+// period has to start so its target is reached when the period begins
+class OptimalStart {
+public:
+  OptimalStart();
+
+  // Minutes needed to go from value to target at this outside temperature
+  float leadMinutes(OptimalStartKind kind, float outside, float value, float target) const;
+  // Call periodically with the current value and target (0 = none). A heat-up starts when the target
+  // rises above the value, ends when the value reaches it and is learned if it completed undisturbed.
+  void track(OptimalStartKind kind, uint32_t now, float outside, float value, float target);
+
+  // Table column of an outside temperature
+  static uint8_t bucket(float outside);
+
+  OptimalStartTable table;
+  uint32_t learned = 0;
+
+private:
+  struct HeatUp {
+    bool active;
+    uint32_t startMs;
+    float startValue;
+    float target;
+    uint8_t bucket;
+  };
+  HeatUp heatUp[OPTSTART_KINDS];
+  float lastTarget[OPTSTART_KINDS];
+};
+
+#endif
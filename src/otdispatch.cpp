@@ -0,0 +1,64 @@
+// otdispatch.cpp
+
+#include "otdispatch.h"
+
+float otDecode(OtDecoder decoder, uint16_t data) {
+  switch (decoder) {
+    case OT_F88: return otDataToFloat(data);
+    case OT_FLAG8_HB: return data >> 8;
+    case OT_FLAG8_LB: return data & 0xFF;
+    case OT_U16: return data;
+    case OT_S16: return (int16_t)data;
+  }
+  return 0;
+}
+
+static float median3(float a, float b, float c) {
+  if (a > b) {
+    float t = a;
+    a = b;
+    b = t;
+  }
+  // a <= b now, the median depends on where c falls
+  if (c < a) return a;
+  if (c > b) return b;
+  return c;
+}
+
+float otApplyFilter(OtFilter filter, float param, OtFilterState& state, float value, uint32_t now) {
+  float previous = state.values[0];
+  uint32_t elapsed = now - state.lastMs;
+  bool first = state.count == 0;
+  state.values[2] = state.values[1];
+  state.values[1] = state.values[0];
+  state.values[0] = value;
+  if (state.count < 3) state.count++;
+  state.lastMs = now;
+  if (first) return value;
+
+  switch (filter) {
+    case OT_FILTER_NONE:
+      return value;
+    case OT_FILTER_EMA:
+      // keep the filtered value as history, not the raw one
+      state.values[0] = previous + param * (value - previous);
+      return state.values[0];
+    case OT_FILTER_MEDIAN3:
+      if (state.count < 3) return value;
+      return median3(state.values[0], state.values[1], state.values[2]);
+    case OT_FILTER_RATE: {
+      float step = param * elapsed / 1000.0f;
+      if (value > previous + step) state.values[0] = previous + step;
+      else if (value < previous - step) state.values[0] = previous - step;
+      return state.values[0];
+    }
+  }
+  return value;
+}
+
+void otDispatch(const OtReading& reading, OtFilterState& state, uint32_t response, OtResponseStatus status, uint32_t now) {
+  if (reading.handler) reading.handler(response, status, now);
+  if (status != OT_SUCCESS || reading.target == nullptr) return;
+  float value = otDecode(reading.decoder, otData(response));
+  *reading.target = otApplyFilter(reading.filter, reading.param, state, value, now);
+}
@@ -0,0 +1,70 @@
+// otdispatch.h
+
+#ifndef OTDISPATCH_H
+#define OTDISPATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "otframe.h"
+
+// How the 16 data bits of a response become a reading
+enum OtDecoder : uint8_t {
+  OT_F88,       // signed fixed point, 1/256
+  OT_FLAG8_HB,  // flag byte in the high byte
+  OT_FLAG8_LB,  // flag byte in the low byte
+  OT_U16,
+  OT_S16
+};
+
+enum OtFilter : uint8_t {
+  OT_FILTER_NONE,
+  OT_FILTER_EMA,      // param: weight of the new value, 0..1
+  OT_FILTER_MEDIAN3,  // median of the last three values, removes single spikes
+  OT_FILTER_RATE      // param: largest change per second
+};
+
+// Optional hook for IDs that need more than one value (status flags, fault codes),
+// called for every response of the ID, including failed ones, with the capture time
+typedef void (*OtReadingHandler)(uint32_t response, OtResponseStatus status, uint32_t ms);
+
+// One row of the response registry
+struct OtReading {
+  uint8_t id;
+  OtDecoder decoder;
+  float* target;  // decoded and filtered value of successful responses, may be nullptr
+  OtFilter filter;
+  float param;
+  OtReadingHandler handler;
+};
+
+struct OtFilterState {
+  float values[3];  // newest first
+  uint8_t count;
+  uint32_t lastMs;
+};
+
+// Registry of the handled response IDs. The ID to row index is built at compile time,
+// a response is dispatched with one array lookup instead of comparing it against every ID.
+template <size_t N>
+class OtReadingTable {
+public:
+  constexpr OtReadingTable(const OtReading (&readings)[N]) : readings(readings), slot() {
+    for (size_t i = 0; i < N; i++) slot[readings[i].id] = i + 1;
+  }
+
+  // Row of an ID, -1 if it has none
+  int16_t find(uint8_t id) const { return (int16_t)slot[id] - 1; }
+  const OtReading& reading(uint8_t index) const { return readings[index]; }
+  static constexpr size_t size() { return N; }
+
+private:
+  const OtReading* readings;
+  uint8_t slot[256];  // row + 1, 0 = not registered
+};
+
+float otDecode(OtDecoder decoder, uint16_t data);
+float otApplyFilter(OtFilter filter, float param, OtFilterState& state, float value, uint32_t now);
+// Runs the handler, then decodes and filters a successful response into the target
+void otDispatch(const OtReading& reading, OtFilterState& state, uint32_t response, OtResponseStatus status, uint32_t now);
+
+#endif
@@ -0,0 +1,113 @@
+// otframe.h
+
+#ifndef OTFRAME_H
+#define OTFRAME_H
+
+#include <stdint.h>
+
+// OpenTherm 2.2 frame layout: parity(1) | msg type(3) | spare(4) | data id(8) | data value(16).
+// Portable versions of the OpenTherm library helpers, so the control logic also builds on the host.
+
+enum OtMessageType : uint8_t {
+  // master to slave
+  OT_READ_DATA = 0,
+  OT_WRITE_DATA = 1,
+  OT_INVALID_DATA = 2,
+  OT_RESERVED = 3,
+  // slave to master
+  OT_READ_ACK = 4,
+  OT_WRITE_ACK = 5,
+  OT_DATA_INVALID = 6,
+  OT_UNKNOWN_DATA_ID = 7
+};
+
+// Same order as OpenThermResponseStatus of the OpenTherm library
+enum OtResponseStatus : uint8_t {
+  OT_NONE,
+  OT_SUCCESS,
+  OT_INVALID,
+  OT_TIMEOUT
+};
+
+// Data IDs used by the controller, values as in OpenThermMessageID
+namespace OtId {
+enum : uint8_t {
+  Status = 0,
+  TSet = 1,
+  ASFflags = 5,
+  MaxRelModLevelSetting = 14,
+  RelModLevel = 17,
+  CHPressure = 18,
+  DHWFlowRate = 19,
+  Tboiler = 25,
+  Tdhw = 26,
+  Toutside = 27,
+  Tret = 28,
+  Texhaust = 33,
+  TdhwSet = 56,
+  MaxTSet = 57,
+  OEMDiagnosticCode = 115,
+  BurnerStarts = 116,
+  CHPumpStarts = 117,
+  DHWPumpValveStarts = 118,
+  DHWBurnerStarts = 119,
+  BurnerOperationHours = 120,
+  CHPumpOperationHours = 121,
+  DHWPumpValveOperationHours = 122,
+  DHWBurnerOperationHours = 123
+};
+}
+
+// true if the number of set bits is odd
+inline bool otParity(uint32_t frame) {
+  uint8_t p = 0;
+  while (frame > 0) {
+    if (frame & 1) p++;
+    frame >>= 1;
+  }
+  return p & 1;
+}
+
+inline uint32_t otBuildFrame(uint8_t type, uint8_t id, uint16_t data) {
+  uint32_t frame = data;
+  frame |= (uint32_t)id << 16;
+  frame |= (uint32_t)(type & 0x7) << 28;
+  if (otParity(frame)) frame |= 0x80000000UL;
+  return frame;
+}
+
+inline uint8_t otMessageType(uint32_t frame) { return (frame >> 28) & 0x7; }
+inline uint8_t otDataId(uint32_t frame) { return (frame >> 16) & 0xFF; }
+inline uint16_t otData(uint32_t frame) { return frame & 0xFFFF; }
+
+inline bool otIsValidResponse(uint32_t frame) {
+  if (otParity(frame)) return false;
+  uint8_t type = otMessageType(frame);
+  return type == OT_READ_ACK || type == OT_WRITE_ACK;
+}
+
+// f8.8 signed fixed point
+inline float otDataToFloat(uint16_t data) {
+  return (data & 0x8000) ? -(0x10000L - data) / 256.0f : data / 256.0f;
+}
+inline float otGetFloat(uint32_t frame) { return otDataToFloat(otData(frame)); }
+
+// Setpoints are limited to 0..100 °C like in the OpenTherm library
+inline uint16_t otTemperatureToData(float temperature) {
+  if (temperature < 0) temperature = 0;
+  if (temperature > 100) temperature = 100;
+  return (uint16_t)(temperature * 256);
+}
+
+// Master status flags in the high byte of a Status request
+inline uint16_t otStatusData(bool centralHeating, bool hotWater, bool cooling) {
+  return (uint16_t)((centralHeating ? 1 : 0) | (hotWater ? 2 : 0) | (cooling ? 4 : 0)) << 8;
+}
+
+// Slave status flags in the low byte of a Status response
+inline bool otIsFault(uint32_t frame) { return frame & 0x1; }
+inline bool otIsCentralHeatingActive(uint32_t frame) { return frame & 0x2; }
+inline bool otIsHotWaterActive(uint32_t frame) { return frame & 0x4; }
+inline bool otIsFlameOn(uint32_t frame) { return frame & 0x8; }
+
+#endif
@@ -0,0 +1,57 @@
+// otgateway.cpp
+
+#include "otgateway.h"
+
+void OtGateway::begin(OtSlavePort* thermostat, OtBus* boiler, OtRequestFilter filter) {
+  this->thermostat = thermostat;
+  this->boiler = boiler;
+  this->filter = filter;
+  waiting = false;
+}
+
+void OtGateway::forward(uint32_t now) {
+  if (thermostat == nullptr) return;
+  thermostat->process();
+  if (waiting || !boiler->isReady()) return;
+  OtFrame f;
+  while (thermostat->frames.pop(f)) {
+    if (f.status != OT_SUCCESS) {
+      invalid++;
+      continue;
+    }
+    if (now - f.ms > OT_GATEWAY_MAX_WAIT_MS) {
+      late++;
+      continue;
+    }
+    original = f.frame;
+    requestMs = f.ms;
+    sent = filter ? filter(original) : original;
+    if (!boiler->sendRequestAsync(sent)) {
+      late++;
+      return;
+    }
+    if (sent != original) overrides++;
+    forwarded++;
+    waiting = true;
+    return;
+  }
+}
+
+bool OtGateway::onBoilerResponse(uint32_t response, OtResponseStatus status, uint32_t now) {
+  if (!waiting) return false;
+  waiting = false;
+  if (status != OT_SUCCESS) {
+    unanswered++;  // no answer either, the thermostat runs into its own timeout
+    return true;
+  }
+  if (now - requestMs >= OT_GATEWAY_RESPONSE_WINDOW_MS) {
+    late++;  // the thermostat has given up on this request
+    return true;
+  }
+  if (sent != original && otMessageType(response) == OT_WRITE_ACK) {
+    response = otBuildFrame(OT_WRITE_ACK, otDataId(original), otData(original));
+  }
+  thermostat->sendResponse(response);
+  answered++;
+  return true;
+}
@@ -0,0 +1,55 @@
+// otgateway.h
+
+#ifndef OTGATEWAY_H
+#define OTGATEWAY_H
+
+#include <stdint.h>
+#include "hal.h"
+
+// The thermostat expects the answer within 800 ms of its request and repeats the request
+// anyway. A request is only forwarded while the boiler's answer can still make it back in
+// time: after 200 ms in the queue it is dropped, the rest of the window is for the boiler.
+// An answer that comes past the window is not sent, it could collide with the next request.
+#define OT_GATEWAY_RESPONSE_WINDOW_MS 800
+#define OT_GATEWAY_MAX_WAIT_MS 200
+
+// Rewrites a thermostat request on its way to the boiler, returns the request to send
+typedef uint32_t (*OtRequestFilter)(uint32_t request);
+
+// Gateway between a room thermostat (OpenTherm master) and the boiler bus. Each thermostat
+// request is forwarded when the boiler bus is free, possibly rewritten by the filter, and the
+// boiler's response goes back to the thermostat. A rewritten write is acknowledged with the
+// thermostat's own value, so it does not notice the override.
+class OtGateway {
+public:
+  void begin(OtSlavePort* thermostat, OtBus* boiler, OtRequestFilter filter);
+  // Runs the thermostat side and forwards the next request, call on every pass
+  void forward(uint32_t now);
+  // Response of the boiler bus, answers the thermostat unless the window has passed at now.
+  // False if no request was forwarded.
+  bool onBoilerResponse(uint32_t response, OtResponseStatus status, uint32_t now);
+
+  bool active() const { return thermostat != nullptr; }
+  // The forwarded request as the thermostat sent it and as the boiler got it
+  uint32_t originalRequest() const { return original; }
+  uint32_t forwardedRequest() const { return sent; }
+
+  uint32_t forwarded = 0;
+  uint32_t overrides = 0;
+  uint32_t answered = 0;
+  uint32_t unanswered = 0;  // boiler timeout or invalid response
+  uint32_t late = 0;        // dropped after OT_GATEWAY_MAX_WAIT_MS, refused by the boiler bus or
+                            // answered past OT_GATEWAY_RESPONSE_WINDOW_MS
+  uint32_t invalid = 0;     // frames from the thermostat with a parity or framing error
+
+private:
+  OtSlavePort* thermostat = nullptr;
+  OtBus* boiler = nullptr;
+  OtRequestFilter filter = nullptr;
+  uint32_t original = 0;
+  uint32_t sent = 0;
+  uint32_t requestMs = 0;  // capture time of the forwarded request
+  bool waiting = false;
+};
+
+#endif
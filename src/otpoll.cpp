@@ -0,0 +1,90 @@
+// otpoll.cpp
+
+#include "otpoll.h"
+
+// unsupported IDs answer with an invalid frame, back off up to 8x the interval
+#define POLL_MAX_BACKOFF_SHIFT 3
+// retry delay for a change driven request the boiler did not acknowledge
+#define POLL_RETRY_MS 1000
+
+OtPollScheduler::OtPollScheduler(PollEntry* table, uint8_t count) : table(table), count(count) {
+  for (uint8_t i = 0; i < count; i++) {
+    table[i].lastSent = 0;
+    table[i].acknowledged = false;
+    table[i].failures = 0;
+    table[i].requests = 0;
+    table[i].successes = 0;
+    table[i].timeouts = 0;
+    table[i].invalid = 0;
+  }
+}
+
+static inline uint32_t backoff(uint32_t ms, uint8_t failures) {
+  return ms << (failures < POLL_MAX_BACKOFF_SHIFT ? failures : POLL_MAX_BACKOFF_SHIFT);
+}
+
+uint32_t OtPollScheduler::interval(const PollEntry& e) const {
+  uint32_t ms = (fastMode && e.fastIntervalMs > 0) ? e.fastIntervalMs : e.intervalMs;
+  return backoff(ms, e.failures);
+}
+
+bool OtPollScheduler::next(uint32_t now, uint8_t& index, uint16_t& data) {
+  int16_t best = -1;
+  uint32_t bestLate = 0;
+  uint16_t bestData = 0;
+
+  for (uint8_t i = 0; i < count; i++) {
+    const PollEntry& e = table[i];
+    uint16_t value = e.value ? e.value() : 0;
+    uint32_t age = now - e.lastSent;
+    uint32_t ms = interval(e);
+    bool due;
+    if (e.requests == 0) {
+      due = true;
+    } else if (e.value && value != e.lastValue) {
+      due = true;  // changed, don't wait for the keep-alive
+    } else if (e.value && !e.acknowledged) {
+      due = age >= backoff(POLL_RETRY_MS, e.failures);
+    } else {
+      due = age >= ms;
+    }
+    uint32_t late = age > ms ? age - ms : 0;
+    if (!due) continue;
+    if (best < 0 || e.priority > table[best].priority
+        || (e.priority == table[best].priority && late > bestLate)) {
+      best = i;
+      bestLate = late;
+      bestData = value;
+    }
+  }
+
+  if (best < 0) return false;
+  index = best;
+  data = bestData;
+  return true;
+}
+
+void OtPollScheduler::sent(uint8_t index, uint32_t now, uint16_t data) {
+  PollEntry& e = table[index];
+  e.lastSent = now;
+  e.lastValue = data;
+  e.acknowledged = false;
+  e.requests++;
+  pending = index;
+}
+
+void OtPollScheduler::responseReceived(OtResponseStatus status) {
+  if (pending < 0) return;
+  PollEntry& e = table[pending];
+  pending = -1;
+  bool success = status == OT_SUCCESS;
+  e.acknowledged = success;
+  if (success) e.successes++;
+  else if (status == OT_TIMEOUT) e.timeouts++;
+  else e.invalid++;
+  if (success) {
+    e.failures = 0;
+  } else if (e.failures < 255) {
+    e.failures++;
+  }
+}
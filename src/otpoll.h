@@ -0,0 +1,60 @@
+// otpoll.h
+
+#ifndef OTPOLL_H
+#define OTPOLL_H
+
+#include <stdint.h>
+#include "otframe.h"
+
+// Current data word of a change driven request (setpoints, status flags)
+typedef uint16_t (*PollValue)();
+
+// One OpenTherm data ID in the poll schedule
+struct PollEntry {
+  uint8_t id;             // OpenThermMessageID
+  uint8_t type;           // OpenThermMessageType used for the request
+  uint8_t priority;       // higher wins when several entries are due
+  uint32_t intervalMs;    // refresh interval, keep-alive interval for change driven entries
+  uint32_t fastIntervalMs;  // interval while fast mode is on (burner active), 0 = intervalMs
+  PollValue value;        // nullptr = plain read, otherwise sent again as soon as the value changes
+
+  // runtime state, leave out of the table initializer
+  uint32_t lastSent;
+  uint16_t lastValue;
+  bool acknowledged;      // last request got a valid response
+  uint8_t failures;       // consecutive failed responses, slows the entry down
+  uint32_t requests;
+  uint32_t successes;
+  uint32_t timeouts;
+  uint32_t invalid;       // invalid frames and unknown data IDs
+};
+
+// Picks the next OpenTherm request from a table of entries
+class OtPollScheduler {
+public:
+  OtPollScheduler(PollEntry* table, uint8_t count);
+
+  // Returns false if nothing is due, the bus stays idle then
+  bool next(uint32_t now, uint8_t& index, uint16_t& data);
+  // Call after the request was handed to the bus
+  void sent(uint8_t index, uint32_t now, uint16_t data);
+  // Call from the response callback, applies to the request in flight
+  void responseReceived(OtResponseStatus status);
+
+  void setFastMode(bool fast) { fastMode = fast; }
+
+  uint8_t size() const { return count; }
+  const PollEntry& entry(uint8_t index) const { return table[index]; }
+
+  uint32_t refused = 0;  // requests the bus did not take, counted by the caller
+
+private:
+  uint32_t interval(const PollEntry& e) const;
+
+  PollEntry* table;
+  uint8_t count;
+  bool fastMode = false;
+  int16_t pending = -1;
+};
+
+#endif
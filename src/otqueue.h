@@ -0,0 +1,71 @@
+// otqueue.h
+
+#ifndef OTQUEUE_H
+#define OTQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "otframe.h"
+
+// Slots of a bus's frame queue, a power of two. One request is in flight per bus, so the
+// queue only fills up when the decoder does not run for several response times.
+#define OT_QUEUE_SIZE 16
+// Frames the decoder takes from a queue per call
+#define OT_DECODE_BATCH 4
+
+// A response as the bus delivered it
+struct OtFrame {
+  uint32_t frame;
+  uint32_t ms;  // millis() at capture
+  OtResponseStatus status;
+};
+
+// Lock-free single-producer/single-consumer ring between the bus side (response callback or
+// interrupt) and the decoder in the main loop. Only the producer writes head and the producer
+// counters, only the consumer writes tail. The release store of an index publishes the slot
+// to the other side, so neither side ever waits or masks interrupts. One slot stays empty to
+// tell a full ring from an empty one.
+class OtFrameQueue {
+public:
+  // Producer side, false (and counted) when the ring is full
+  bool push(uint32_t frame, OtResponseStatus status, uint32_t ms) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    uint8_t next = (h + 1) & (OT_QUEUE_SIZE - 1);
+    uint8_t t = tail.load(std::memory_order_acquire);
+    if (next == t) {
+      dropped++;
+      return false;
+    }
+    slots[h] = { frame, ms, status };
+    head.store(next, std::memory_order_release);
+    pushed++;
+    uint8_t used = (next - t) & (OT_QUEUE_SIZE - 1);
+    if (used > highWater) highWater = used;
+    return true;
+  }
+
+  // Consumer side, false when empty
+  bool pop(OtFrame& out) {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    out = slots[t];
+    tail.store((t + 1) & (OT_QUEUE_SIZE - 1), std::memory_order_release);
+    return true;
+  }
+
+  uint8_t size() const {
+    return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)) & (OT_QUEUE_SIZE - 1);
+  }
+
+  // producer counters
+  uint32_t pushed = 0;
+  uint32_t dropped = 0;
+  uint8_t highWater = 0;
+
+private:
+  OtFrame slots[OT_QUEUE_SIZE];
+  std::atomic<uint8_t> head{ 0 };
+  std::atomic<uint8_t> tail{ 0 };
+};
+
+#endif
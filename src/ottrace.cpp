@@ -0,0 +1,45 @@
+// ottrace.cpp
+
+#include "ottrace.h"
+
+void OtTrace::record(uint32_t request, uint32_t response, OtResponseStatus status, OtTraceSource source,
+                     bool overridden, uint32_t ms) {
+  uint32_t delta = count ? ms - lastMs : 0;
+  lastMs = ms;
+  if (count == 0) oldestMs = ms;
+  uint16_t slot;
+  if (count < OT_TRACE_ENTRIES) {
+    slot = (first + count) % OT_TRACE_ENTRIES;
+    count++;
+  } else {
+    // the next entry becomes the oldest
+    slot = first;
+    first = (first + 1) % OT_TRACE_ENTRIES;
+    oldestMs += entries[first].deltaMs;
+  }
+  OtTraceEntry& e = entries[slot];
+  e.request = request;
+  e.response = response;
+  e.deltaMs = delta > 0xFFFF ? 0xFFFF : delta;
+  e.flags = (status & OT_TRACE_FLAG_STATUS) | (source == OT_TRACE_THERMOSTAT ? OT_TRACE_FLAG_THERMOSTAT : 0) |
+            (overridden ? OT_TRACE_FLAG_OVERRIDDEN : 0);
+  recorded++;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int32_t otTraceReplay(const uint8_t* data, uint32_t length, OtTraceReplayHandler handler) {
+  if (length < OT_TRACE_HEADER_BYTES || data[0] != 'T' || data[1] != OT_TRACE_FORMAT_VERSION) return -1;
+  uint16_t count = data[2] | data[3] << 8;
+  if (length < OT_TRACE_HEADER_BYTES + (uint32_t)count * OT_TRACE_ENTRY_BYTES) return -1;
+  uint32_t ms = getU32(&data[4]);
+  const uint8_t* p = data + OT_TRACE_HEADER_BYTES;
+  for (uint16_t i = 0; i < count; i++, p += OT_TRACE_ENTRY_BYTES) {
+    OtTraceEntry e = { getU32(&p[0]), getU32(&p[4]), (uint16_t)(p[8] | p[9] << 8), p[10] };
+    if (i > 0) ms += e.deltaMs;  // the oldest entry's delta points at an overwritten one
+    handler(e, ms);
+  }
+  return count;
+}
@@ -0,0 +1,87 @@
+// ottrace.h
+
+#ifndef OTTRACE_H
+#define OTTRACE_H
+
+#include <stdint.h>
+#include "otframe.h"
+
+// Request/response pairs kept, about 3 kB of RAM
+#define OT_TRACE_ENTRIES 256
+// Export format, see OtTrace::exportTo()
+#define OT_TRACE_FORMAT_VERSION 1
+#define OT_TRACE_HEADER_BYTES 8
+#define OT_TRACE_ENTRY_BYTES 11
+
+// Who sent the request of a pair
+enum OtTraceSource : uint8_t {
+  OT_TRACE_CONTROLLER,  // own poll schedule
+  OT_TRACE_THERMOSTAT   // forwarded in gateway mode
+};
+
+// Flags byte of an entry
+#define OT_TRACE_FLAG_STATUS 0x03      // OtResponseStatus
+#define OT_TRACE_FLAG_THERMOSTAT 0x04  // source
+#define OT_TRACE_FLAG_OVERRIDDEN 0x08  // the gateway rewrote the request
+
+struct OtTraceEntry {
+  uint32_t request;
+  uint32_t response;
+  uint16_t deltaMs;  // since the previous entry, saturated
+  uint8_t flags;
+};
+
+// Ring of the latest request/response pairs on the boiler bus, the oldest is overwritten
+class OtTrace {
+public:
+  void record(uint32_t request, uint32_t response, OtResponseStatus status, OtTraceSource source, bool overridden,
+              uint32_t ms);
+  void clear() { count = 0; }
+
+  uint16_t size() const { return count; }
+  const OtTraceEntry& entry(uint16_t age) const {  // 0 = oldest
+    return entries[(first + age) % OT_TRACE_ENTRIES];
+  }
+  uint32_t exportSize() const { return OT_TRACE_HEADER_BYTES + (uint32_t)count * OT_TRACE_ENTRY_BYTES; }
+
+  // Streams the ring as one message, little endian:
+  //   'T', version, entry count (u16), millis of the oldest entry (u32)
+  //   per entry, oldest first: request (u32), response (u32), ms since the previous entry (u16), flags (u8)
+  // Writer needs writePayload(const uint8_t* data, uint16_t length)
+  template <class Writer>
+  void exportTo(Writer& out) const {
+    uint8_t header[OT_TRACE_HEADER_BYTES] = { 'T', OT_TRACE_FORMAT_VERSION, (uint8_t)count, (uint8_t)(count >> 8) };
+    putU32(&header[4], oldestMs);
+    out.writePayload(header, sizeof(header));
+    for (uint16_t i = 0; i < count; i++) {
+      const OtTraceEntry& e = entry(i);
+      uint8_t b[OT_TRACE_ENTRY_BYTES];
+      putU32(&b[0], e.request);
+      putU32(&b[4], e.response);
+      b[8] = e.deltaMs;
+      b[9] = e.deltaMs >> 8;
+      b[10] = e.flags;
+      out.writePayload(b, sizeof(b));
+    }
+  }
+
+  uint32_t recorded = 0;
+
+private:
+  static void putU32(uint8_t* p, uint32_t v) {
+    for (uint8_t i = 0; i < 4; i++) p[i] = v >> (8 * i);
+  }
+
+  OtTraceEntry entries[OT_TRACE_ENTRIES];
+  uint16_t first = 0;
+  uint16_t count = 0;
+  uint32_t oldestMs = 0;
+  uint32_t lastMs = 0;
+};
+
+// Feeds the pairs of an export to a handler with their original times, e.g. to replay field
+// traffic into the decoders on the host. Returns the number of pairs, -1 if the data is not a trace.
+typedef void (*OtTraceReplayHandler)(const OtTraceEntry& entry, uint32_t ms);
+int32_t otTraceReplay(const uint8_t* data, uint32_t length, OtTraceReplayHandler handler);
+
+#endif
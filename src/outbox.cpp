@@ -0,0 +1,71 @@
+// outbox.cpp
+
+#include <string.h>
+#include "outbox.h"
+#include "fixedstring.h"
+
+void MqttOutbox::push(uint8_t key, float value, uint32_t now) {
+  if (count == OUTBOX_CAPACITY) {
+    first = (first + 1) % OUTBOX_CAPACITY;
+    count--;
+    dropped++;
+  }
+  OutboxEntry& e = entries[(first + count) % OUTBOX_CAPACITY];
+  e.time = now;
+  e.value = value;
+  e.key = key;
+  count++;
+  if (count > highWater) highWater = count;
+}
+
+// Appends text if it fits, returns false otherwise
+static bool appendText(char* buf, uint16_t& len, const char* text) {
+  uint16_t n = strlen(text);
+  if (len + n >= OUTBOX_BATCH_BYTES) return false;
+  memcpy(buf + len, text, n + 1);
+  len += n;
+  return true;
+}
+
+uint8_t MqttOutbox::flush(MqttLink& link, const char* topic, const char* const keys[], uint32_t now, uint32_t utc) {
+  if (!link.isConnected()) {
+    connected = false;
+    return 0;
+  }
+  if (!connected) {
+    connected = true;
+    connectedAt = now;
+  }
+  if (count == 0 || now - connectedAt < OUTBOX_RECONNECT_DELAY_MS) return 0;
+
+  char buf[OUTBOX_BATCH_BYTES];
+  char number[16];
+  uint16_t len = 0;
+  formatInt(number, sizeof(number), utc);
+  appendText(buf, len, "{\"utc\":");
+  appendText(buf, len, number);
+  appendText(buf, len, ",\"v\":[");
+  uint8_t n = 0;
+  for (; n < OUTBOX_BATCH && n < count; n++) {
+    const OutboxEntry& e = entries[(first + n) % OUTBOX_CAPACITY];
+    uint16_t start = len;
+    bool fits = appendText(buf, len, n ? ",[" : "[");
+    formatInt(number, sizeof(number), (now - e.time) / 1000);
+    fits = fits && appendText(buf, len, number) && appendText(buf, len, ",\"") && appendText(buf, len, keys[e.key]);
+    formatFloat(number, sizeof(number), e.value, 2);
+    fits = fits && appendText(buf, len, "\",") && appendText(buf, len, number) && appendText(buf, len, "]");
+    // keep room for the closing brackets
+    if (!fits || len + 2 >= OUTBOX_BATCH_BYTES) {
+      len = start;
+      break;
+    }
+  }
+  appendText(buf, len, "]}");
+  if (n == 0 || !link.publish(topic, (const uint8_t*)buf, len, false)) return 0;
+
+  first = (first + n) % OUTBOX_CAPACITY;
+  count -= n;
+  sent += n;
+  batches++;
+  return n;
+}
@@ -0,0 +1,46 @@
+// outbox.h
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdint.h>
+#include "hal.h"
+
+#define OUTBOX_CAPACITY 192
+// Entries per message and size of the message buffer
+#define OUTBOX_BATCH 16
+#define OUTBOX_BATCH_BYTES 512
+// Let discovery and the fresh state go first after a reconnect
+#define OUTBOX_RECONNECT_DELAY_MS 2000
+
+struct OutboxEntry {
+  uint32_t time;  // millis() of the change
+  float value;
+  uint8_t key;    // index into the key names given to flush()
+};
+
+// Store-and-forward queue for sensor changes while the broker is unreachable. When full the
+// oldest entry is dropped. After a reconnect the entries are sent in batches, one per flush():
+//   {"utc":<now, 0 if unknown>,"v":[[<age s>,"<key>",<value>],...]}
+class MqttOutbox {
+public:
+  void push(uint8_t key, float value, uint32_t now);
+  // Sends at most one batch if the link is up and the reconnect delay is over,
+  // returns the number of entries sent
+  uint8_t flush(MqttLink& link, const char* topic, const char* const keys[], uint32_t now, uint32_t utc);
+
+  uint16_t size() const { return count; }
+  uint16_t highWater = 0;
+  uint32_t dropped = 0;
+  uint32_t sent = 0;
+  uint32_t batches = 0;
+
+private:
+  OutboxEntry entries[OUTBOX_CAPACITY];
+  uint16_t first = 0;
+  uint16_t count = 0;
+  bool connected = false;
+  uint32_t connectedAt = 0;
+};
+
+#endif
@@ -0,0 +1,31 @@
+// pid.cpp
+
+#include "pid.h"
+
+PidController::PidController(float kp, float ki, float kd, float outMin, float outMax)
+  : kp(kp), ki(ki), kd(kd), outMin(outMin), outMax(outMax) {}
+
+void PidController::reset() {
+  p = i = d = output = 0.0;
+  started = false;
+}
+
+float PidController::update(float setpoint, float measurement, float dt) {
+  float error = setpoint - measurement;
+  p = kp * error;
+  d = (started && dt > 0) ? -kd * (measurement - lastMeasurement) / dt : 0.0;
+  lastMeasurement = measurement;
+  started = true;
+
+  // integrate only if that does not push a saturated output further out
+  float candidate = i + ki * error * dt;
+  float unclamped = p + candidate + d;
+  if (!(unclamped > outMax && candidate > i) && !(unclamped < outMin && candidate < i)) i = candidate;
+  if (i > outMax) i = outMax;
+  if (i < outMin) i = outMin;
+
+  output = p + i + d;
+  if (output > outMax) output = outMax;
+  if (output < outMin) output = outMin;
+  return output;
+}
@@ -0,0 +1,34 @@
+// pid.h
+
+#ifndef PID_H
+#define PID_H
+
+// PID with derivative on the measurement and anti-windup: the integral stops growing while the
+// output is saturated in the same direction and is clamped to the output range
+class PidController {
+public:
+  PidController(float kp, float ki, float kd, float outMin, float outMax);
+
+  // dt in seconds, returns the limited output
+  float update(float setpoint, float measurement, float dt);
+  // Forget integral and derivative state, e.g. when the measurement went stale
+  void reset();
+
+  float kp;
+  float ki;  // per second
+  float kd;  // seconds
+  float outMin;
+  float outMax;
+
+  // terms of the last update, for monitoring
+  float p = 0.0;
+  float i = 0.0;
+  float d = 0.0;
+  float output = 0.0;
+
+private:
+  float lastMeasurement = 0.0;
+  bool started = false;
+};
+
+#endif
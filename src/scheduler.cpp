@@ -0,0 +1,99 @@
+// scheduler.cpp
+
+#include <string.h>
+#include "scheduler.h"
+
+// true if time a is at or after time b, safe across the millis() rollover
+static inline bool timeReached(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) >= 0;
+}
+
+Scheduler::Scheduler(SchedulerClock clock) : clock(clock) {
+  passDurations.clear();
+}
+
+int8_t Scheduler::addTask(const char* name, TaskCallback callback, uint32_t periodMs, uint32_t deadlineMs) {
+  if (count >= SCHEDULER_MAX_TASKS || callback == nullptr) return -1;
+  Task& t = tasks[count];
+  t.name = name;
+  t.callback = callback;
+  t.periodMs = periodMs;
+  t.deadlineMs = deadlineMs;
+  t.nextRun = clock();
+  t.enabled = true;
+  t.runs = 0;
+  t.overruns = 0;
+  t.skipped = 0;
+  t.lastJitterMs = 0;
+  t.maxJitterMs = 0;
+  t.lastDurationMs = 0;
+  t.maxDurationMs = 0;
+  t.histogram.clear();
+  return count++;
+}
+
+void Scheduler::run() {
+  passCount++;
+  uint32_t passStart = microsClock ? microsClock() : 0;
+  for (uint8_t i = 0; i < count; i++) {
+    Task& t = tasks[i];
+    uint32_t now = clock();
+    if (!t.enabled || !timeReached(now, t.nextRun)) continue;
+
+    // tasks that run on every pass are due when the pass reaches them, not after the last run
+    uint32_t due = t.periodMs > 0 ? t.nextRun : now;
+    t.lastJitterMs = now - due;
+    if (t.lastJitterMs > t.maxJitterMs) t.maxJitterMs = t.lastJitterMs;
+
+    uint32_t startUs = microsClock ? microsClock() : 0;
+    t.callback();
+    if (microsClock) t.histogram.add(microsClock() - startUs);
+
+    uint32_t end = clock();
+    t.runs++;
+    t.lastDurationMs = end - now;
+    if (t.lastDurationMs > t.maxDurationMs) t.maxDurationMs = t.lastDurationMs;
+    if (end - due > t.deadlineMs) t.overruns++;
+
+    // fixed rate: keep the phase, but don't try to catch up on missed periods
+    t.nextRun = due + t.periodMs;
+    if (t.periodMs > 0 && timeReached(end, t.nextRun)) {
+      t.skipped += (end - due) / t.periodMs;
+      t.nextRun = end + t.periodMs;
+    } else if (t.periodMs == 0) {
+      t.nextRun = end;
+    }
+  }
+  if (microsClock) passDurations.add(microsClock() - passStart);
+}
+
+void Scheduler::setEnabled(int8_t index, bool enabled) {
+  if (index < 0 || index >= count) return;
+  tasks[index].enabled = enabled;
+  if (enabled) tasks[index].nextRun = clock();
+}
+
+void Scheduler::runAt(int8_t index, uint32_t when) {
+  if (index < 0 || index >= count) return;
+  tasks[index].nextRun = when;
+}
+
+int8_t Scheduler::find(const char* name) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (strcmp(tasks[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+void Scheduler::resetStats() {
+  for (uint8_t i = 0; i < count; i++) {
+    Task& t = tasks[i];
+    t.runs = 0;
+    t.overruns = 0;
+    t.skipped = 0;
+    t.maxJitterMs = 0;
+    t.maxDurationMs = 0;
+    t.histogram.clear();
+  }
+  passDurations.clear();
+}
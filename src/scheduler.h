@@ -0,0 +1,69 @@
+// scheduler.h
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include "metrics.h"
+
+// Maximum number of tasks the scheduler can hold
+#define SCHEDULER_MAX_TASKS 20
+
+// Time source in milliseconds, millis() on the board or a fake clock on the host
+typedef uint32_t (*SchedulerClock)();
+typedef void (*TaskCallback)();
+
+// One periodic job and its timing statistics
+struct Task {
+  const char* name;
+  TaskCallback callback;
+  uint32_t periodMs;      // 0 = run on every pass
+  uint32_t deadlineMs;    // allowed time from due time until the task has finished
+  uint32_t nextRun;
+  uint32_t runs;
+  uint32_t overruns;      // runs that finished after their deadline
+  uint32_t skipped;       // periods dropped because the task fell behind
+  uint32_t lastJitterMs;  // start delay relative to the due time
+  uint32_t maxJitterMs;
+  uint32_t lastDurationMs;
+  uint32_t maxDurationMs;
+  LatencyHistogram histogram;  // run durations, with a microsecond clock
+  bool enabled;
+};
+
+// Tick based cooperative scheduler, tasks run in the order they were added
+class Scheduler {
+public:
+  explicit Scheduler(SchedulerClock clock);
+
+  // Returns the task index or -1 if the table is full
+  int8_t addTask(const char* name, TaskCallback callback, uint32_t periodMs, uint32_t deadlineMs);
+
+  // Runs every task that is due, call this from loop()
+  void run();
+
+  // Optional microsecond clock for the duration histograms of the tasks and the passes
+  void setMicrosClock(SchedulerClock micros) { microsClock = micros; }
+
+  void setEnabled(int8_t index, bool enabled);
+  // Moves the next run of a task, e.g. to now after an event it should react to right away
+  void runAt(int8_t index, uint32_t when);
+  // Index of the task with this name, -1 if there is none
+  int8_t find(const char* name) const;
+  void resetStats();
+
+  uint8_t taskCount() const { return count; }
+  const Task& task(uint8_t index) const { return tasks[index]; }
+  uint32_t passes() const { return passCount; }
+  const LatencyHistogram& passHistogram() const { return passDurations; }
+
+private:
+  SchedulerClock clock;
+  SchedulerClock microsClock = nullptr;
+  LatencyHistogram passDurations;
+  Task tasks[SCHEDULER_MAX_TASKS];
+  uint8_t count = 0;
+  uint32_t passCount = 0;
+};
+
+#endif
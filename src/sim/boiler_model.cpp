@@ -0,0 +1,214 @@
+// boiler_model.cpp
+
+#include <math.h>
+#include "boiler_model.h"
+#include "../otframe.h"
+
+// Heat given off by people and appliances [W]
+#define INTERNAL_GAINS 300.0f
+// Boiler modulation gain on the flow temperature error [W/K]
+#define MODULATION_GAIN 1500.0f
+// Return from the tank coil above the tank temperature [K]
+#define COIL_APPROACH 5.0f
+
+static uint16_t floatToData(float value) {
+  return (uint16_t)(int16_t)lroundf(value * 256);
+}
+
+// Hot water draws: short morning shower, hand washing at noon, evening showers
+static float drawPower(float hours) {
+  if (hours >= 6.5f && hours < 6.67f) return 15000.0f;
+  if (hours >= 12.0f && hours < 12.17f) return 3000.0f;
+  if (hours >= 19.0f && hours < 19.33f) return 10000.0f;
+  return 0.0f;
+}
+
+BoilerModelParams BoilerModel::defaults() {
+  BoilerModelParams params;
+  params.houseUA = 150.0f;
+  params.houseCapacity = 20e6f;
+  params.radiatorK = 100.0f;
+  params.loopCapacity = 40.0f * 4186.0f;
+  params.pumpFlow = 0.2f * 4186.0f;
+  params.burnerMaxPower = 20000.0f;
+  params.burnerMinPower = 4000.0f;
+  params.boilers = 1;
+  params.flowHysteresis = 5.0f;
+  params.tankCapacity = 150.0f * 4186.0f;
+  params.tankUA = 2.0f;
+  params.tankHysteresis = 5.0f;
+  params.comfortTemp = 20.5f;
+  params.outsideMean = 0.0f;
+  params.outsideSwing = 4.0f;
+  return params;
+}
+
+BoilerModel::BoilerModel(const BoilerModelParams& params) : p(params) {
+  if (p.boilers < 1) p.boilers = 1;
+  if (p.boilers > MODEL_MAX_BOILERS) p.boilers = MODEL_MAX_BOILERS;
+  units[0].lifetimeStarts = 12000;
+  units[0].lifetimeBurnerSeconds = 3000.0f * 3600.0f;
+  resetDay();
+  totals = day;
+  totals.minRoom = room;
+  totals.maxRoom = room;
+}
+
+void BoilerModel::resetDay() {
+  day.gasKWh = 0;
+  day.heatKWh = 0;
+  day.burnerOnMinutes = 0;
+  day.burnerStarts = 0;
+  day.comfortDeviationKh = 0;
+  day.minRoom = room;
+  day.maxRoom = room;
+  day.dhwColdMinutes = 0;
+  day.dhwHeatKWh = 0;
+}
+
+float BoilerModel::outsideAt(uint32_t localSeconds) const {
+  // coldest at 05:00
+  float hours = (localSeconds % 86400) / 3600.0f;
+  return p.outsideMean - p.outsideSwing * cosf((hours - 5.0f) * (float)M_PI / 12.0f);
+}
+
+void BoilerModel::step(float dt, uint32_t localSeconds) {
+  float hours = (localSeconds % 86400) / 3600.0f;
+  outside = outsideAt(localSeconds);
+
+  // DHW tank: draws and standing loss
+  float draw = drawPower(hours);
+  drawFlow = draw / (4186.0f * (40.0f - 10.0f)) * 60.0f;  // 40 °C at the tap from 10 °C cold water
+  tank -= (draw + p.tankUA * (tank - room)) * dt / p.tankCapacity;
+  if (tank < 10.0f) tank = 10.0f;  // cold water inlet
+
+  // boiler 0: DHW has priority. CH runs on/off with modulation in between, the boilers on
+  // the heating circuit share the radiator load.
+  charging = units[0].dhwEnabled && (charging ? tank < units[0].tdhwSet : tank < units[0].tdhwSet - p.tankHysteresis);
+  bool pump = false;
+  uint8_t heating = 0;
+  for (uint8_t b = 0; b < p.boilers; b++) {
+    pump |= units[b].chEnabled;
+    if (units[b].chEnabled && units[b].tSet > room && !(b == 0 && charging)) heating++;
+  }
+  float radiator = 0.0f;
+  if (pump && flow > room) radiator = p.radiatorK * powf(((flow + ret) / 2) - room, 1.3f);
+  float loopHeat = 0.0f;
+  float anyBurner = 0.0f;
+  for (uint8_t b = 0; b < p.boilers; b++) {
+    BoilerUnit& u = units[b];
+    bool wasOn = u.power > 0;
+    float limit = p.burnerMinPower + (p.burnerMaxPower - p.burnerMinPower) * u.maxModulation / 100.0f;
+    if (b == 0 && charging) {
+      u.power = p.burnerMaxPower;
+    } else if (u.chEnabled && u.tSet > room) {
+      bool on = wasOn ? flow < u.tSet + p.flowHysteresis : flow < u.tSet - p.flowHysteresis;
+      if (on) {
+        u.power = MODULATION_GAIN * (u.tSet - flow) + radiator / heating;
+        if (u.power < p.burnerMinPower) u.power = p.burnerMinPower;
+        if (u.power > limit) u.power = limit;
+      } else {
+        u.power = 0.0f;
+      }
+    } else {
+      u.power = 0.0f;
+    }
+    if (!wasOn && u.power > 0) {
+      day.burnerStarts++;
+      u.lifetimeStarts++;
+      u.starts++;
+    }
+    if (u.power > 0) {
+      u.lifetimeBurnerSeconds += dt;
+      u.burnerSeconds += dt;
+    }
+    if (u.chEnabled) u.chEnabledSeconds += dt;
+    u.heatKWh += u.power * dt / 3.6e6f;
+    if (!(b == 0 && charging)) loopHeat += u.power;
+    if (u.power > anyBurner) anyBurner = u.power;
+
+    // condensing only works with a cold return
+    float returnTemp = (b == 0 && charging) ? tank : ret;
+    float efficiency = returnTemp < 50.0f ? 0.97f : 0.88f;
+    day.heatKWh += u.power * dt / 3.6e6f;
+    day.gasKWh += u.power / efficiency * dt / 3.6e6f;
+  }
+
+  // heating circuit and building
+  if (charging) {
+    tank += units[0].power * dt / p.tankCapacity;
+    day.dhwHeatKWh += units[0].power * dt / 3.6e6f;
+    chargeReturn = tank + COIL_APPROACH;
+    chargeFlow = chargeReturn + units[0].power / p.pumpFlow;
+  }
+  flow += (loopHeat - radiator) * dt / p.loopCapacity;
+  ret = pump ? flow - radiator / p.pumpFlow : flow;
+  room += (radiator + INTERNAL_GAINS - p.houseUA * (room - outside)) * dt / p.houseCapacity;
+
+  if (anyBurner > 0) day.burnerOnMinutes += dt / 60.0f;
+  if (hours >= 6.0f && hours < 22.0f) day.comfortDeviationKh += fabsf(room - p.comfortTemp) * dt / 3600.0f;
+  if (room < day.minRoom) day.minRoom = room;
+  if (room > day.maxRoom) day.maxRoom = room;
+  if (draw > 0 && tank < 40.0f) day.dhwColdMinutes += dt / 60.0f;
+}
+
+uint32_t BoilerModel::respond(uint8_t boiler, uint32_t request) {
+  BoilerUnit& u = units[boiler];
+  uint8_t type = otMessageType(request);
+  uint8_t id = otDataId(request);
+  uint16_t data = otData(request);
+  bool write = type == OT_WRITE_DATA;
+  uint8_t ack = write ? OT_WRITE_ACK : OT_READ_ACK;
+
+  switch (id) {
+    case OtId::Status: {
+      u.chEnabled = data & 0x100;
+      u.dhwEnabled = boiler == 0 && (data & 0x200);
+      bool flame = u.power > 0;
+      bool dhw = boiler == 0 && charging;
+      uint8_t slave = ((u.chEnabled && flame && !dhw) ? 0x2 : 0) | (dhw ? 0x4 : 0) | (flame ? 0x8 : 0);
+      return otBuildFrame(OT_READ_ACK, id, (data & 0xFF00) | slave);
+    }
+    case OtId::TSet:
+      if (write) u.tSet = otDataToFloat(data);
+      return otBuildFrame(ack, id, floatToData(u.tSet));
+    case OtId::MaxRelModLevelSetting:
+      if (write) u.maxModulation = otDataToFloat(data);
+      return otBuildFrame(ack, id, floatToData(u.maxModulation));
+    case OtId::TdhwSet:
+      if (boiler != 0) return otBuildFrame(OT_UNKNOWN_DATA_ID, id, data);
+      if (write) u.tdhwSet = otDataToFloat(data);
+      return otBuildFrame(ack, id, floatToData(u.tdhwSet));
+    case OtId::Tboiler: return otBuildFrame(OT_READ_ACK, id, floatToData(boiler == 0 && charging ? chargeFlow : flow));
+    case OtId::Tret: return otBuildFrame(OT_READ_ACK, id, floatToData(boiler == 0 && charging ? chargeReturn : ret));
+    case OtId::Tdhw: return otBuildFrame(OT_READ_ACK, id, floatToData(tank));
+    case OtId::Toutside: return otBuildFrame(OT_READ_ACK, id, floatToData(outside));
+    case OtId::Texhaust: return otBuildFrame(OT_READ_ACK, id, floatToData(u.power > 0 ? ret + 15.0f : room));
+    case OtId::RelModLevel: {
+      float modulation = u.power > 0 ? 100.0f * (u.power - p.burnerMinPower) / (p.burnerMaxPower - p.burnerMinPower) : 0.0f;
+      return otBuildFrame(OT_READ_ACK, id, floatToData(modulation));
+    }
+    // sealed system: pressure rises with the water temperature
+    case OtId::CHPressure: return otBuildFrame(OT_READ_ACK, id, floatToData(1.3f + (flow - 20.0f) * 0.01f));
+    case OtId::DHWFlowRate: return otBuildFrame(OT_READ_ACK, id, floatToData(drawFlow));
+    case OtId::ASFflags: return otBuildFrame(OT_READ_ACK, id, 0);
+    case OtId::BurnerStarts: return otBuildFrame(OT_READ_ACK, id, u.lifetimeStarts & 0xFFFF);
+    case OtId::BurnerOperationHours: return otBuildFrame(OT_READ_ACK, id, (uint32_t)(u.lifetimeBurnerSeconds / 3600) & 0xFFFF);
+    default: return otBuildFrame(OT_UNKNOWN_DATA_ID, id, data);
+  }
+}
+
+BoilerDayStats BoilerModel::closeDay() {
+  BoilerDayStats finished = day;
+  totals.gasKWh += day.gasKWh;
+  totals.heatKWh += day.heatKWh;
+  totals.burnerOnMinutes += day.burnerOnMinutes;
+  totals.burnerStarts += day.burnerStarts;
+  totals.comfortDeviationKh += day.comfortDeviationKh;
+  totals.dhwColdMinutes += day.dhwColdMinutes;
+  totals.dhwHeatKWh += day.dhwHeatKWh;
+  if (day.minRoom < totals.minRoom) totals.minRoom = day.minRoom;
+  if (day.maxRoom > totals.maxRoom) totals.maxRoom = day.maxRoom;
+  resetDay();
+  return finished;
+}
@@ -0,0 +1,112 @@
+// boiler_model.h
+
+#ifndef BOILER_MODEL_H
+#define BOILER_MODEL_H
+
+#include <stdint.h>
+
+// Lumped thermal model of a house with radiators, a DHW tank and one or more modulating
+// gas boilers that answer OpenTherm frames like real slaves would. Boiler 0 also charges the
+// tank, the others only feed the heating circuit.
+
+#define MODEL_MAX_BOILERS 3
+
+struct BoilerModelParams {
+  float houseUA;          // heat loss of the building [W/K]
+  float houseCapacity;    // thermal mass of the building [J/K]
+  float radiatorK;        // radiator output = k * (mean water temp - room)^1.3 [W]
+  float loopCapacity;     // water in boiler and heating circuit [J/K]
+  float pumpFlow;         // circuit mass flow * cp [W/K]
+  float burnerMaxPower;   // per boiler [W]
+  float burnerMinPower;   // lowest modulation [W]
+  uint8_t boilers;        // boilers on the heating circuit, 1..MODEL_MAX_BOILERS
+  float flowHysteresis;   // boiler internal on/off band around TSet [K]
+  float tankCapacity;     // DHW tank [J/K]
+  float tankUA;           // standing loss of the tank [W/K]
+  float tankHysteresis;   // tank is recharged below TdhwSet - hysteresis [K]
+  float comfortTemp;      // room target while occupied [°C]
+  float outsideMean;      // daily mean outside temperature [°C]
+  float outsideSwing;     // daily amplitude around the mean [K]
+};
+
+// Figures of one simulated day
+struct BoilerDayStats {
+  float gasKWh;
+  float heatKWh;
+  float burnerOnMinutes;
+  uint32_t burnerStarts;
+  float comfortDeviationKh;  // |room - comfort| integrated over the occupied hours
+  float minRoom;
+  float maxRoom;
+  float dhwColdMinutes;      // minutes with hot water drawn from a tank below 40 °C
+  float dhwHeatKWh;          // heat put into the tank
+};
+
+// One boiler: commands from its master, state and counters
+struct BoilerUnit {
+  bool chEnabled = false;
+  bool dhwEnabled = false;
+  float tSet = 0.0;
+  float tdhwSet = 0.0;
+  float maxModulation = 100.0;  // [%] written by the master
+  float power = 0.0;            // [W]
+  // lifetime counters as the boiler reports them
+  uint32_t lifetimeStarts = 0;
+  float lifetimeBurnerSeconds = 0.0;
+  // since the start of the simulation
+  uint32_t starts = 0;
+  float burnerSeconds = 0.0;
+  float chEnabledSeconds = 0.0;
+  float heatKWh = 0.0;
+};
+
+class BoilerModel {
+public:
+  explicit BoilerModel(const BoilerModelParams& params);
+
+  static BoilerModelParams defaults();
+
+  // Advance the model by dt seconds, localSeconds is the local time of day for occupancy and draws
+  void step(float dt, uint32_t localSeconds);
+  // OpenTherm slave of a boiler: response frame for a request frame
+  uint32_t respond(uint32_t request) { return respond(0, request); }
+  uint32_t respond(uint8_t boiler, uint32_t request);
+
+  // Returns the finished day and starts a new one
+  BoilerDayStats closeDay();
+  const BoilerDayStats& total() const { return totals; }
+
+  float outsideTemp() const { return outside; }
+  // Outside temperature profile, also what a perfect forecast would say
+  float outsideAt(uint32_t localSeconds) const;
+  float roomTemp() const { return room; }
+  float flowTemp() const { return flow; }
+  float returnTemp() const { return ret; }
+  float tankTemp() const { return tank; }
+  bool flameOn() const { return units[0].power > 0; }
+  const BoilerUnit& unit(uint8_t boiler) const { return units[boiler]; }
+
+private:
+  void resetDay();
+
+  BoilerModelParams p;
+
+  BoilerUnit units[MODEL_MAX_BOILERS];
+
+  // state
+  float outside = 0.0;
+  float room = 20.0;
+  float flow = 30.0;
+  float ret = 25.0;
+  float tank = 45.0;
+  bool charging = false;  // boiler 0 heats the tank (DHW priority)
+  // boiler 0's water through the tank coil while charging, what its sensors report then
+  float chargeFlow = 0.0;
+  float chargeReturn = 0.0;
+  float drawFlow = 0.0;   // DHW tapping [l/min]
+
+  BoilerDayStats day;
+  BoilerDayStats totals;
+};
+
+#endif
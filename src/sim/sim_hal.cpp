@@ -0,0 +1,174 @@
+// sim_hal.cpp
+
+#include <stdio.h>
+#include <string.h>
+#include "sim_hal.h"
+
+// Minimum pause between two OpenTherm transactions
+#define OT_BUS_DELAY_MS 100
+
+FakeOtBus::FakeOtBus(Clock& clock, OtResponder responder, uint32_t latencyMs, uint32_t timeoutMs)
+  : clock(clock), responder(responder), latencyMs(latencyMs), timeoutMs(timeoutMs) {}
+
+bool FakeOtBus::isReady() {
+  return state == READY;
+}
+
+bool FakeOtBus::sendRequestAsync(uint32_t request) {
+  if (state != READY) return false;
+  requests++;
+  response = responder(request);  // the slave decides right away, the answer is delivered later
+  state = WAITING;
+  since = clock.millis();
+  return true;
+}
+
+void FakeOtBus::process() {
+  uint32_t now = clock.millis();
+  if (state == WAITING) {
+    uint32_t wait = response != 0 ? latencyMs : timeoutMs;
+    if (now - since < wait) return;
+    state = DELAY;
+    since = now;
+    OtResponseStatus status = OT_SUCCESS;
+    if (response == 0) {
+      status = OT_TIMEOUT;
+      timeouts++;
+    } else if (!otIsValidResponse(response)) {
+      status = OT_INVALID;
+      invalid++;
+    } else {
+      responses++;
+    }
+    frames.push(response, status, now);
+  } else if (state == DELAY && now - since >= OT_BUS_DELAY_MS) {
+    state = READY;
+  }
+}
+
+FakeThermostat::FakeThermostat(Clock& clock, OtMasterScript script, uint32_t periodMs)
+  : clock(clock), script(script), periodMs(periodMs) {}
+
+bool FakeThermostat::sendResponse(uint32_t response) {
+  if (pending == 0 || !otIsValidResponse(response) || otDataId(response) != otDataId(pending)) {
+    mismatched++;
+    return false;
+  }
+  responses++;
+  pending = 0;
+  return true;
+}
+
+void FakeThermostat::process() {
+  uint32_t now = clock.millis();
+  if (pending != 0 && now - sentAt >= 800) {
+    unanswered++;
+    pending = 0;
+  }
+  if (requests > 0 && now - sentAt < periodMs) return;
+  pending = script(step++);
+  sentAt = now;
+  requests++;
+  frames.push(pending, OT_SUCCESS, now);
+}
+
+void FakeDisplay::setCursor(uint8_t c, uint8_t r) {
+  col = c;
+  row = r;
+  cursorMoves++;
+}
+
+size_t FakeDisplay::write(uint8_t c) {
+  if (row < LCD_ROWS && col < LCD_COLS) cells[row][col++] = c;
+  writes++;
+  return 1;
+}
+
+void FakeMqtt::localIp(uint8_t ip[4]) {
+  const uint8_t address[4] = { 127, 0, 0, 1 };
+  memcpy(ip, address, 4);
+}
+
+bool FakeMqtt::beginPublish(const char* topic, uint16_t length, bool retained) {
+  if (!isConnected()) return false;
+  expected = length;
+  written = 0;
+  bytes += strlen(topic);
+  return true;
+}
+
+void FakeMqtt::writePayload(const uint8_t* data, uint16_t length) {
+  written += length;
+  bytes += length;
+}
+
+bool FakeMqtt::endPublish() {
+  if (written != expected) {
+    halLog("FakeMqtt: payload length differs from beginPublish");
+    return false;
+  }
+  publishes++;
+  return true;
+}
+
+bool FakeMqtt::subscribe(const char* topic) {
+  if (!isConnected()) return false;
+  subscriptions++;
+  return true;
+}
+
+FileFlash::FileFlash(const char* path, uint16_t sectors, uint32_t sectorBytes) : sectors(sectors), sectorBytes(sectorBytes) {
+  file = fopen(path, "r+b");
+  if (file == nullptr) {
+    // new device: erased flash
+    file = fopen(path, "w+b");
+    if (file == nullptr) return;
+    for (uint32_t i = 0; i < (uint32_t)sectors * sectorBytes; i++) fputc(0xFF, file);
+    fflush(file);
+  }
+}
+
+FileFlash::~FileFlash() {
+  if (file) fclose(file);
+}
+
+bool FileFlash::inRange(uint32_t address, uint32_t length) const {
+  return file && address % 4 == 0 && length % 4 == 0 && address + length <= (uint32_t)sectors * sectorBytes;
+}
+
+bool FileFlash::read(uint32_t address, void* data, uint32_t length) {
+  if (!inRange(address, length)) return false;
+  fseek(file, address, SEEK_SET);
+  return fread(data, 1, length, file) == length;
+}
+
+bool FileFlash::write(uint32_t address, const void* data, uint32_t length) {
+  if (!inRange(address, length)) return false;
+  uint8_t current[256];
+  const uint8_t* in = (const uint8_t*)data;
+  for (uint32_t done = 0; done < length;) {
+    uint32_t n = length - done < sizeof(current) ? length - done : sizeof(current);
+    fseek(file, address + done, SEEK_SET);
+    if (fread(current, 1, n, file) != n) return false;
+    for (uint32_t i = 0; i < n; i++) current[i] &= in[done + i];
+    fseek(file, address + done, SEEK_SET);
+    if (fwrite(current, 1, n, file) != n) return false;
+    done += n;
+  }
+  fflush(file);
+  bytesWritten += length;
+  return true;
+}
+
+bool FileFlash::eraseSector(uint16_t sector) {
+  if (!file || sector >= sectors) return false;
+  fseek(file, (uint32_t)sector * sectorBytes, SEEK_SET);
+  for (uint32_t i = 0; i < sectorBytes; i++) fputc(0xFF, file);
+  fflush(file);
+  erases++;
+  return true;
+}
+
+void halLog(const char* message) {
+  fprintf(stderr, "%s\n", message);
+}
@@ -0,0 +1,137 @@
+// sim_hal.h
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdio.h>
+#include "../hal.h"
+#include "../lcdframe.h"
+
+// Host fakes for the HAL, time only moves when the simulation advances it
+
+class FakeClock : public Clock {
+public:
+  uint32_t millis() override { return now; }
+  void advance(uint32_t ms) { now += ms; }
+
+  uint32_t now = 0;
+};
+
+// Answers a request frame with a response frame, 0 = no answer (timeout)
+typedef uint32_t (*OtResponder)(uint32_t request);
+
+// OpenTherm bus with the timing of the OpenTherm library: the response arrives
+// after the slave latency, the next request may go out 100 ms after that
+class FakeOtBus : public OtBus {
+public:
+  FakeOtBus(Clock& clock, OtResponder responder, uint32_t latencyMs = 80, uint32_t timeoutMs = 1000);
+
+  bool isReady() override;
+  bool sendRequestAsync(uint32_t request) override;
+  void process() override;
+
+  uint32_t requests = 0;
+  uint32_t responses = 0;
+  uint32_t timeouts = 0;
+  uint32_t invalid = 0;
+
+private:
+  enum State { READY, WAITING, DELAY };
+
+  Clock& clock;
+  OtResponder responder;
+  uint32_t latencyMs;
+  uint32_t timeoutMs;
+  State state = READY;
+  uint32_t since = 0;
+  uint32_t response = 0;
+};
+
+// Next request frame of a scripted OpenTherm master
+typedef uint32_t (*OtMasterScript)(uint32_t step);
+
+// Room thermostat as the master on the gateway's slave port: one request per period from the
+// script, an answer has to come within 800 ms and has to match the request's data ID
+class FakeThermostat : public OtSlavePort {
+public:
+  FakeThermostat(Clock& clock, OtMasterScript script, uint32_t periodMs = 1000);
+
+  bool sendResponse(uint32_t response) override;
+  void process() override;
+
+  uint32_t requests = 0;
+  uint32_t responses = 0;
+  uint32_t unanswered = 0;
+  uint32_t mismatched = 0;  // late, invalid or for another data ID
+
+private:
+  Clock& clock;
+  OtMasterScript script;
+  uint32_t periodMs;
+  uint32_t step = 0;
+  uint32_t sentAt = 0;
+  uint32_t pending = 0;  // request waiting for its answer, 0 = none
+};
+
+class FakeDisplay : public CharDisplay {
+public:
+  void setCursor(uint8_t col, uint8_t row) override;
+  size_t write(uint8_t c) override;
+
+  char cells[LCD_ROWS][LCD_COLS + 1] = {};
+  uint32_t writes = 0;
+  uint32_t cursorMoves = 0;
+
+private:
+  uint8_t col = 0;
+  uint8_t row = 0;
+};
+
+class FakeMqtt : public MqttLink {
+public:
+  bool isNetworkConnected() override { return network; }
+  int16_t rssi() override { return -60; }
+  void localIp(uint8_t ip[4]) override;
+  bool isConnected() override { return network && broker; }
+  bool beginPublish(const char* topic, uint16_t length, bool retained) override;
+  void writePayload(const uint8_t* data, uint16_t length) override;
+  bool endPublish() override;
+  bool subscribe(const char* topic) override;
+
+  bool network = true;
+  bool broker = true;
+  uint32_t publishes = 0;
+  uint32_t bytes = 0;
+  uint32_t subscriptions = 0;
+
+private:
+  uint16_t expected = 0;  // announced length of the publish in progress
+  uint16_t written = 0;
+};
+
+// Flash kept in a file so the configuration survives between runs. Writes AND into
+// the existing bits like NOR flash does, erases are counted per sector.
+class FileFlash : public Flash {
+public:
+  FileFlash(const char* path, uint16_t sectors, uint32_t sectorBytes = 4096);
+  ~FileFlash();
+  bool isOpen() const { return file != nullptr; }
+
+  uint32_t sectorSize() override { return sectorBytes; }
+  uint16_t sectorCount() override { return sectors; }
+  bool read(uint32_t address, void* data, uint32_t length) override;
+  bool write(uint32_t address, const void* data, uint32_t length) override;
+  bool eraseSector(uint16_t sector) override;
+
+  uint32_t erases = 0;
+  uint32_t bytesWritten = 0;
+
+private:
+  bool inRange(uint32_t address, uint32_t length) const;
+
+  FILE* file = nullptr;
+  uint16_t sectors;
+  uint32_t sectorBytes;
+};
+
+#endif
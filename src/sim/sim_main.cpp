@@ -0,0 +1,300 @@
+// sim_main.cpp
+//
+// Host build of the control loop (pio run -e native). Runs the controller against
+// fake hardware and a simulated house as fast as the CPU allows:
+// .pio/build/native/program [days] [mean outside temperature] [flash file or -] [building time constant h]
+//                               [room sensor 0/1] [weekly schedule JSON or -] [boilers 1..3]
+//                               [trace file or -] [gateway 0/1]
+// .pio/build/native/program replay <trace file> [repeat]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../controller.h"
+#include "sim_hal.h"
+#include "boiler_model.h"
+
+// Simulated time per scheduler pass
+#define SIM_STEP_MS 10
+// 2024-01-15 00:00 UTC, a Monday in the heating season
+#define SIM_START_EPOCH 1705276800UL
+
+uint64_t simElapsedMs = 0;
+
+uint32_t simEpoch() {
+  return SIM_START_EPOCH + simElapsedMs / 1000;
+}
+
+BoilerModel boiler(BoilerModel::defaults());
+
+uint32_t boilerResponder(uint32_t request) {
+  return boiler.respond(request);
+}
+
+// cascade boilers 2 and 3 on their own buses
+uint32_t boilerResponder1(uint32_t request) {
+  return boiler.respond(1, request);
+}
+
+uint32_t boilerResponder2(uint32_t request) {
+  return boiler.respond(2, request);
+}
+
+FakeClock simClock;
+FakeOtBus simBus(simClock, boilerResponder);
+FakeOtBus simExtraBus[HAL_MAX_EXTRA_BUSES] = { { simClock, boilerResponder1 }, { simClock, boilerResponder2 } };
+FakeDisplay simDisplay;
+FakeMqtt simMqtt;
+
+// On/off room thermostat for the gateway mode: heat on below 20.5 °C, off above 21 °C, fixed
+// 60 °C flow and 50 °C DHW. Status every other second, readings and setpoints in between.
+uint32_t thermostatScript(uint32_t step) {
+  static bool call = false;
+  static const uint8_t ids[] = { OtId::TSet, OtId::Tboiler, OtId::Tdhw, OtId::Tret, OtId::RelModLevel, OtId::TdhwSet,
+                                 OtId::Toutside };
+  if (step % 2 == 0) {
+    if (boiler.roomTemp() < 20.5) call = true;
+    if (boiler.roomTemp() > 21.0) call = false;
+    return otBuildFrame(OT_READ_DATA, OtId::Status, otStatusData(call, true, false));
+  }
+  uint8_t id = ids[(step / 2) % sizeof(ids)];
+  if (id == OtId::TSet) return otBuildFrame(OT_WRITE_DATA, id, otTemperatureToData(60));
+  if (id == OtId::TdhwSet) return otBuildFrame(OT_WRITE_DATA, id, otTemperatureToData(50));
+  return otBuildFrame(OT_READ_DATA, id, 0);
+}
+
+FakeThermostat simThermostat(simClock, thermostatScript);
+
+uint32_t simClockMillis() {
+  return simClock.millis();
+}
+
+// CET, the simulation stays in winter time
+#define SIM_UTC_OFFSET 3600
+
+int32_t simUtcOffset(uint32_t utc) {
+  return SIM_UTC_OFFSET;
+}
+
+void pushForecast() {
+  char payload[FORECAST_HOURS * 8];
+  int len = snprintf(payload, sizeof(payload), "%u", simEpoch());
+  for (uint8_t k = 0; k < 24; k++) {
+    len += snprintf(payload + len, sizeof(payload) - len, ",%.1f", boiler.outsideAt(simEpoch() + SIM_UTC_OFFSET + k * 3600));
+  }
+  mqttMessage("hzg/forecast", (const uint8_t*)payload, len);
+}
+
+void printDay(const char* label, const BoilerDayStats& d) {
+  printf("%-6s %8.1f %8.1f %8.0f %7u %9.1f %6.1f %6.1f %7.0f %7.2f\n", label, d.gasKWh, d.heatKWh, d.burnerOnMinutes,
+         d.burnerStarts, d.comfortDeviationKh, d.minRoom, d.maxRoom, d.dhwColdMinutes, d.dhwHeatKWh);
+}
+
+TimeService timeService(simEpoch, simUtcOffset, 3600000, 30000);
+Scheduler scheduler(simClockMillis);
+
+// Task durations are real CPU time of the host, not simulated time
+uint32_t wallMicros() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint32_t)(t.tv_sec * 1000000ULL + t.tv_nsec / 1000);
+}
+
+// Streams a trace export into a file
+struct FileWriter {
+  FILE* file;
+  void writePayload(const uint8_t* data, uint16_t length) { fwrite(data, 1, length, file); }
+};
+
+uint32_t replayed[2];  // controller, thermostat
+uint32_t replayedOverrides = 0;
+uint32_t replayedFailures = 0;
+
+void replayPair(const OtTraceEntry& e, uint32_t ms) {
+  simClock.now = ms;
+  replayed[(e.flags & OT_TRACE_FLAG_THERMOSTAT) ? 1 : 0]++;
+  if (e.flags & OT_TRACE_FLAG_OVERRIDDEN) replayedOverrides++;
+  OtResponseStatus status = (OtResponseStatus)(e.flags & OT_TRACE_FLAG_STATUS);
+  if (status != OT_SUCCESS) replayedFailures++;
+  decodeResponse(e.response, status, ms);
+}
+
+// Feeds a trace downloaded from hzg/trace to the decoders with the recorded times, then again
+// repeat - 1 times for the decoding throughput
+int replay(const char* path, int repeat) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return 1;
+  }
+  static uint8_t data[OT_TRACE_HEADER_BYTES + OT_TRACE_ENTRIES * OT_TRACE_ENTRY_BYTES];
+  uint32_t length = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  hal = { &simBus, &simDisplay, &simClock, &simMqtt, nullptr, { nullptr, nullptr }, nullptr };
+
+  int32_t pairs = otTraceReplay(data, length, replayPair);
+  if (pairs < 0) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    return 1;
+  }
+  printf("trace: %d pairs, %u own, %u forwarded (%u overridden), %u without valid response, %.1f s\n", pairs,
+         replayed[0], replayed[1], replayedOverrides, replayedFailures, (simClock.now - (data[4] | data[5] << 8 |
+         data[6] << 16 | (uint32_t)data[7] << 24)) / 1000.0);
+  printf("decoded: outside %.1f, flow %.1f, return %.1f, DHW %.1f, modulation %.0f %%, %s, %.0f starts\n", outsideTemp,
+         boilerTemp, returnWaterTemp, dhwTemp, relModLevel, state.c_str(), burnerStarts);
+
+  timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+  for (int i = 1; i < repeat; i++) otTraceReplay(data, length, replayPair);
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  double wall = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+  if (repeat > 1 && pairs > 0) {
+    double n = (double)pairs * (repeat - 1);
+    printf("replayed %.0f pairs in %.3f s, %.0f ns per pair\n", n, wall, wall * 1e9 / n);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2 && strcmp(argv[1], "replay") == 0) return replay(argv[2], argc > 3 ? atoi(argv[3]) : 1);
+  int days = argc > 1 ? atoi(argv[1]) : 7;
+  BoilerModelParams params = BoilerModel::defaults();
+  if (argc > 2) params.outsideMean = atof(argv[2]);
+  // a cascade splits the same installed power over several smaller boilers
+  int boilers = argc > 7 ? atoi(argv[7]) : 1;
+  if (boilers < 1) boilers = 1;
+  if (boilers > 1 + HAL_MAX_EXTRA_BUSES) boilers = 1 + HAL_MAX_EXTRA_BUSES;
+  params.boilers = boilers;
+  params.burnerMaxPower /= boilers;
+  params.burnerMinPower /= boilers;
+  boiler = BoilerModel(params);
+
+  FileFlash* flash = argc > 3 && strcmp(argv[3], "-") != 0 ? new FileFlash(argv[3], 2 * CONFIG_SECTORS) : nullptr;
+  hal = { &simBus, &simDisplay, &simClock, &simMqtt, flash && flash->isOpen() ? flash : nullptr, { nullptr, nullptr } };
+  for (int i = 1; i < boilers; i++) hal.extraBus[i - 1] = &simExtraBus[i - 1];
+  const char* tracePath = argc > 8 && strcmp(argv[8], "-") != 0 ? argv[8] : nullptr;
+  if (argc > 9 && atoi(argv[9]) != 0) hal.thermostat = &simThermostat;
+  setupController();
+  if (argc > 4) buildingTimeConstant = atof(argv[4]);
+  bool roomSensor = argc > 5 && atoi(argv[5]) != 0;
+  if (argc > 6 && strcmp(argv[6], "-") != 0) mqttMessage("hzg/schedule/set", (const uint8_t*)argv[6], strlen(argv[6]));
+  if (hal.flash) {
+    printf("config: sequence %u, morning DHW %.1f\n", configStore.sequence(), dhwTempMorningSP);
+  }
+  addControllerTasks(scheduler);
+  scheduler.setMicrosClock(wallMicros);
+
+  timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  printf("%-6s %8s %8s %8s %7s %9s %6s %6s %7s %7s\n", "day", "gas kWh", "heat kWh", "burn min", "starts",
+         "comfort", "minRm", "maxRm", "dhwCold", "dhw kWh");
+  uint64_t endMs = (uint64_t)days * 86400000ULL;
+  while (simElapsedMs < endMs) {
+    scheduler.run();
+    simClock.advance(SIM_STEP_MS);
+    simElapsedMs += SIM_STEP_MS;
+    // day 1, 12:00: someone drags the morning DHW slider from 40 to 45 °C in Home Assistant
+    if (simElapsedMs >= 43200000ULL && simElapsedMs <= 43205000ULL && simElapsedMs % 500 == 0) {
+      dhwTempMorningSP = 40.0 + (simElapsedMs - 43200000ULL) / 1000.0;
+      scheduleChanged = true;
+    }
+    // hourly forecast push, the model's own profile for the next 24 h
+    if (simElapsedMs % 3600000ULL == 0) pushForecast();
+    // room thermostat reporting through Home Assistant every 5 minutes
+    if (roomSensor && simElapsedMs % 300000ULL == 0) {
+      char payload[16];
+      int len = snprintf(payload, sizeof(payload), "%.1f", boiler.roomTemp());
+      mqttMessage("hzg/room/temperature", (const uint8_t*)payload, len);
+    }
+    if (simElapsedMs % 1000 == 0) boiler.step(1.0, simEpoch() + SIM_UTC_OFFSET);
+    if (simElapsedMs % 86400000ULL == 0) {
+      char label[8];
+      snprintf(label, sizeof(label), "%u", (unsigned)(simElapsedMs / 86400000ULL));
+      printDay(label, boiler.closeDay());
+    }
+  }
+  printDay("total", boiler.total());
+
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  double wall = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+  printf("simulated %d days in %.2f s (%.0fx real time)\n", days, wall, days * 86400.0 / wall);
+  printf("bus: %u requests, %u responses, %u timeouts, %u invalid\n",
+         simBus.requests, simBus.responses, simBus.timeouts, simBus.invalid);
+  if (hal.thermostat) {
+    printf("gateway: %u thermostat requests, %u forwarded, %u overridden, %u answered, %u unanswered, %u late\n",
+           simThermostat.requests, otGateway.forwarded, otGateway.overrides, simThermostat.responses,
+           otGateway.unanswered + simThermostat.unanswered, otGateway.late);
+  }
+  printf("dhw: %u charges, %.2f kWh counted (model %.2f kWh into the tank), last %.2f kWh in %.0f min from %.1f to "
+         "%.1f °C\n", dhwCharge.charges(), dhwCharge.totalKWh(), boiler.total().dhwHeatKWh, dhwCharge.last().kWh,
+         dhwCharge.last().durationMs / 60000.0, dhwCharge.last().startTemp, dhwCharge.last().endTemp);
+  printf("frame queue: %u frames, %u dropped, high-water %u of %u\n", simBus.frames.pushed, simBus.frames.dropped,
+         simBus.frames.highWater, OT_QUEUE_SIZE - 1);
+  if (hal.flash) {
+    printf("config: %u writes, %u flash erases, %u bytes written, %u failures\n", configStore.writes, flash->erases,
+           flash->bytesWritten, configStore.failures);
+  }
+  if (cascade.count() > 1) {
+    printf("cascade: %u boilers, lead %u, %u rotations, %u stage changes\n", cascade.count(), cascade.lead + 1,
+           cascade.rotations, cascade.stageChanges);
+    printf("%-6s %10s %8s %8s %9s %9s %9s %9s\n", "boiler", "enabled h", "starts", "burn h", "heat kWh", "requests",
+           "responses", "timeouts");
+    for (uint8_t i = 0; i < cascade.count(); i++) {
+      const BoilerUnit& u = boiler.unit(i);
+      FakeOtBus& bus = i == 0 ? simBus : simExtraBus[i - 1];
+      printf("%-6u %10.1f %8u %8.1f %9.1f %9u %9u %9u\n", i + 1, u.chEnabledSeconds / 3600, u.starts,
+             u.burnerSeconds / 3600, u.heatKWh, bus.requests, bus.responses, bus.timeouts);
+    }
+  }
+  printf("boiler: %.0f starts, %.0f h, modulation %.0f %%, %.2f bar, fault flags %02X code %u\n", burnerStarts,
+         burnerOperationHours, relModLevel, chPressure, faultFlags, oemFaultCode);
+  printf("schedule: %u CH points%s, %u DHW points%s\n", schedule[SCHEDULE_CH].count,
+         customSchedule[SCHEDULE_CH].count ? " (loaded)" : "", schedule[SCHEDULE_DHW].count,
+         customSchedule[SCHEDULE_DHW].count ? " (loaded)" : "");
+  uint8_t bucket = OptimalStart::bucket(outsideTemp);
+  printf("optimal start: %u heat-ups learned, %.1f min/K DHW, %.1f min/K heating at the current outside temperature\n",
+         optimalStart.learned, optimalStart.table.rate[OPTSTART_DHW][bucket] / 10.0,
+         optimalStart.table.rate[OPTSTART_HEATING][bucket] / 10.0);
+  printf("lcd: %u chars, %u cursor moves, %u I2C bytes\n", simDisplay.writes, simDisplay.cursorMoves, frame.totalI2cBytes());
+  // ask for the whole history like a client on the broker would
+  uint32_t mqttBytes = simMqtt.bytes;
+  mqttMessage("hzg/history/get", nullptr, 0);
+  publishHistory();
+  uint32_t values = history.samples() * HISTORY_CHANNELS;
+  printf("history: %u samples, %u bytes encoded (%.2f bytes/value), %u bytes published\n", history.samples(),
+         history.encodedBytes(), values ? (double)history.encodedBytes() / values : 0.0, simMqtt.bytes - mqttBytes);
+  // and for the bus trace, kept in a file for the replay mode
+  mqttBytes = simMqtt.bytes;
+  mqttMessage("hzg/trace/get", nullptr, 0);
+  publishTrace();
+  printf("trace: %u pairs recorded, the last %u published (%u bytes)\n", otTrace.recorded, otTrace.size(),
+         simMqtt.bytes - mqttBytes);
+  if (tracePath) {
+    FILE* file = fopen(tracePath, "wb");
+    if (file) {
+      FileWriter writer = { file };
+      otTrace.exportTo(writer);
+      fclose(file);
+    }
+  }
+  printf("%-14s %10s %9s %9s %9s %8s %8s\n", "task", "runs", "overruns", "skipped", "maxJitter", "p99 us", "max us");
+  for (uint8_t i = 0; i < scheduler.taskCount(); i++) {
+    const Task& t = scheduler.task(i);
+    printf("%-14s %10u %9u %9u %9u %8u %8u\n", t.name, t.runs, t.overruns, t.skipped, t.maxJitterMs,
+           t.histogram.percentileUs(0.99), t.histogram.maxUs);
+  }
+  static char metrics[1536];
+  SystemMetrics system = { (uint32_t)(simElapsedMs / 1000), 0, 0, simMqtt.rssi() };
+  uint16_t metricsLength = formatMetrics(metrics, sizeof(metrics), system, scheduler, otPoll, simBus.frames,
+                                         otGateway);
+  printf("metrics (%u bytes): %s\n", metricsLength, metrics);
+  // the simulator has no WiFi or broker connection, only the first OpenTherm response is timed
+  char boot[128];
+  formatBootTimes(boot, sizeof(boot), bootTimes, "sim");
+  printf("boot: %s\n", boot);
+  for (uint8_t row = 0; row < LCD_ROWS; row++) printf("|%.20s|\n", simDisplay.cells[row]);
+  return 0;
+}
@@ -0,0 +1,119 @@
+// telemetry.cpp
+
+#include <math.h>
+#include "telemetry.h"
+
+uint8_t historyPutVarint(uint8_t* out, int32_t value) {
+  uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  uint8_t n = 0;
+  while (zigzag >= 0x80) {
+    out[n++] = (zigzag & 0x7F) | 0x80;
+    zigzag >>= 7;
+  }
+  out[n++] = zigzag;
+  return n;
+}
+
+uint8_t historyGetVarint(const uint8_t* in, int32_t& value) {
+  uint32_t zigzag = 0;
+  uint8_t n = 0;
+  uint8_t shift = 0;
+  do {
+    zigzag |= (uint32_t)(in[n] & 0x7F) << shift;
+    shift += 7;
+  } while (in[n++] & 0x80 && n < 5);
+  value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+  return n;
+}
+
+static int16_t toFixed(float value) {
+  if (isnan(value)) return 0;
+  long fixed = lroundf(value * HISTORY_SCALE);
+  if (fixed > HISTORY_LIMIT) fixed = HISTORY_LIMIT;
+  if (fixed < -HISTORY_LIMIT) fixed = -HISTORY_LIMIT;
+  return fixed;
+}
+
+void TelemetryHistory::add(const float values[HISTORY_CHANNELS], uint32_t utc) {
+  HistoryBlock* b = count ? &blocks[(first + count - 1) % HISTORY_BLOCKS] : nullptr;
+  if (b == nullptr || b->samples >= HISTORY_BLOCK_SAMPLES) {
+    if (count == HISTORY_BLOCKS) {
+      first = (first + 1) % HISTORY_BLOCKS;
+      count--;
+    }
+    b = &blocks[(first + count) % HISTORY_BLOCKS];
+    count++;
+    b->start = utc;
+    b->length = 0;
+    b->samples = 1;
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+      last[c] = toFixed(values[c]);
+      b->base[c] = last[c];
+    }
+    return;
+  }
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+    int16_t fixed = toFixed(values[c]);
+    b->length += historyPutVarint(b->data + b->length, fixed - last[c]);
+    last[c] = fixed;
+  }
+  b->samples++;
+}
+
+void TelemetryHistory::clear() {
+  first = 0;
+  count = 0;
+}
+
+uint32_t TelemetryHistory::samples() const {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < count; i++) n += block(i).samples;
+  return n;
+}
+
+uint32_t TelemetryHistory::encodedBytes() const {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < count; i++) n += sizeof(block(i).base) + block(i).length;
+  return n;
+}
+
+bool TelemetryHistory::sample(uint32_t index, float values[HISTORY_CHANNELS]) const {
+  for (uint8_t i = 0; i < count; i++) {
+    const HistoryBlock& b = block(i);
+    if (index >= b.samples) {
+      index -= b.samples;
+      continue;
+    }
+    int32_t fixed[HISTORY_CHANNELS];
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) fixed[c] = b.base[c];
+    const uint8_t* p = b.data;
+    for (uint32_t s = 0; s < index; s++) {
+      for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+        int32_t delta;
+        p += historyGetVarint(p, delta);
+        fixed[c] += delta;
+      }
+    }
+    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) values[c] = (float)fixed[c] / HISTORY_SCALE;
+    return true;
+  }
+  return false;
+}
+
+uint32_t TelemetryHistory::exportSize(uint8_t maxBlocks) const {
+  uint8_t n = maxBlocks < count ? maxBlocks : count;
+  uint32_t size = HISTORY_HEADER_BYTES;
+  for (uint8_t i = count - n; i < count; i++) size += HISTORY_BLOCK_HEADER_BYTES + block(i).length;
+  return size;
+}
+
+void TelemetryHistory::encodeBlockHeader(const HistoryBlock& b, uint8_t* out) {
+  for (uint8_t i = 0; i < 4; i++) out[i] = b.start >> (8 * i);
+  out[4] = b.samples;
+  out[5] = b.length;
+  out[6] = b.length >> 8;
+  for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+    out[7 + 2 * c] = b.base[c];
+    out[8 + 2 * c] = (uint16_t)b.base[c] >> 8;
+  }
+}
@@ -0,0 +1,124 @@
+// telemetry.h
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+// Readings kept per sample, in this order
+enum HistoryChannel : uint8_t {
+  HISTORY_OUTSIDE,
+  HISTORY_BOILER,
+  HISTORY_RETURN,
+  HISTORY_EXHAUST,
+  HISTORY_DHW,
+  HISTORY_CHANNELS
+};
+
+#define HISTORY_INTERVAL_MS 60000UL
+#define HISTORY_BLOCK_SAMPLES 60
+// 24 h of complete blocks plus the one being filled
+#define HISTORY_BLOCKS 25
+// Fixed point: int16 in 1/10 K, clamped to +-300 °C so a delta always fits two varint bytes
+#define HISTORY_SCALE 10
+#define HISTORY_LIMIT 3000
+#define HISTORY_BLOCK_BYTES ((HISTORY_BLOCK_SAMPLES - 1) * HISTORY_CHANNELS * 2)
+// Export format, see TelemetryHistory::exportTo()
+#define HISTORY_FORMAT_VERSION 1
+#define HISTORY_HEADER_BYTES 8
+#define HISTORY_BLOCK_HEADER_BYTES (7 + HISTORY_CHANNELS * 2)
+
+// Zigzag varint helpers, also used by the decoders of the export
+uint8_t historyPutVarint(uint8_t* out, int32_t value);
+uint8_t historyGetVarint(const uint8_t* in, int32_t& value);
+
+// One hour of samples: the first one absolute, every following value as the zigzag
+// varint of its difference to the previous sample of the same channel
+struct HistoryBlock {
+  uint32_t start;                  // UTC of the first sample, 0 if the clock was not synced
+  int16_t base[HISTORY_CHANNELS];  // first sample
+  uint16_t length;                 // used bytes of data
+  uint8_t samples;
+  uint8_t data[HISTORY_BLOCK_BYTES];
+};
+
+// Fixed-size in-RAM history of the boiler readings at one sample per minute
+class TelemetryHistory {
+public:
+  // Appends one sample, the oldest hour is dropped when the ring is full
+  void add(const float values[HISTORY_CHANNELS], uint32_t utc);
+  void clear();
+
+  uint8_t blockCount() const { return count; }
+  // 0 = oldest block
+  const HistoryBlock& block(uint8_t index) const { return blocks[(first + index) % HISTORY_BLOCKS]; }
+  uint32_t samples() const;
+  // Encoded size of the samples, without block headers
+  uint32_t encodedBytes() const;
+  // Decodes sample index (0 = oldest) into values, false if out of range
+  bool sample(uint32_t index, float values[HISTORY_CHANNELS]) const;
+
+  // Calls f(minutesAgo, value) for the newest count samples of a channel, oldest first
+  template <class F>
+  void forEachRecent(uint8_t channel, uint32_t count, F f) const {
+    uint32_t total = samples();
+    if (count > total) count = total;
+    uint32_t skip = total - count;
+    uint32_t age = count;
+    for (uint8_t i = 0; i < this->count; i++) {
+      const HistoryBlock& b = block(i);
+      if (skip >= b.samples) {
+        skip -= b.samples;
+        continue;
+      }
+      int32_t fixed = b.base[channel];
+      const uint8_t* p = b.data;
+      for (uint8_t s = 0; s < b.samples; s++) {
+        if (s > 0) {
+          for (uint8_t c = 0; c < HISTORY_CHANNELS; c++) {
+            int32_t delta;
+            p += historyGetVarint(p, delta);
+            if (c == channel) fixed += delta;
+          }
+        }
+        if (skip > 0) {
+          skip--;
+          continue;
+        }
+        f(--age, (float)fixed / HISTORY_SCALE);
+      }
+    }
+  }
+
+  // Size of the export of the newest maxBlocks blocks
+  uint32_t exportSize(uint8_t maxBlocks) const;
+  // Streams the newest maxBlocks blocks as one message, little endian:
+  //   'H', version, channels, scale, block count, reserved, interval [s] (u16)
+  //   per block: start (u32), samples (u8), length (u16), base (i16 x channels), data
+  // Writer needs writePayload(const uint8_t* data, uint16_t length)
+  template <class Writer>
+  void exportTo(Writer& out, uint8_t maxBlocks) const {
+    uint8_t n = maxBlocks < count ? maxBlocks : count;
+    uint16_t interval = HISTORY_INTERVAL_MS / 1000;
+    uint8_t header[HISTORY_HEADER_BYTES] = { 'H', HISTORY_FORMAT_VERSION, HISTORY_CHANNELS, HISTORY_SCALE, n, 0,
+                                             (uint8_t)interval, (uint8_t)(interval >> 8) };
+    out.writePayload(header, sizeof(header));
+    for (uint8_t i = count - n; i < count; i++) {
+      const HistoryBlock& b = block(i);
+      uint8_t blockHeader[HISTORY_BLOCK_HEADER_BYTES];
+      encodeBlockHeader(b, blockHeader);
+      out.writePayload(blockHeader, sizeof(blockHeader));
+      out.writePayload(b.data, b.length);
+    }
+  }
+
+private:
+  static void encodeBlockHeader(const HistoryBlock& b, uint8_t* out);
+
+  HistoryBlock blocks[HISTORY_BLOCKS];
+  uint8_t first = 0;
+  uint8_t count = 0;
+  int16_t last[HISTORY_CHANNELS] = { 0 };  // previous sample, delta reference
+};
+
+#endif
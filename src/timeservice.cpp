@@ -0,0 +1,66 @@
+// timeservice.cpp
+
+#include "timeservice.h"
+
+// Transitions are at least 5 months apart, so a 120 day window holds one at most
+#define OFFSET_WINDOW_SECONDS (120UL * 86400UL)
+
+TimeService::TimeService(TimeSyncSource sync, UtcOffsetSource offset, uint32_t syncIntervalMs, uint32_t retryIntervalMs)
+  : sync(sync), offset(offset), syncIntervalMs(syncIntervalMs), retryIntervalMs(retryIntervalMs) {}
+
+void TimeService::trySync(uint32_t nowMs) {
+  attempted = true;
+  lastSyncAttemptMs = nowMs;
+  uint32_t epoch = sync();
+  if (epoch == 0) {
+    syncFailures++;
+    return;
+  }
+  utcSeconds = epoch;
+  subSecondMs = 0;
+  lastUpdateMs = nowMs;
+  synced = true;
+  syncCount++;
+  offsetValidUntil = 0;  // the clock may have jumped
+}
+
+void TimeService::refreshOffset() {
+  offsetSeconds = offset(utcSeconds);
+  offsetLookups++;
+
+  // find the next hour at which the offset changes, rules switch on full hours
+  uint32_t lo = utcSeconds / 3600;
+  uint32_t hi = (utcSeconds + OFFSET_WINDOW_SECONDS) / 3600;
+  if (offset(hi * 3600) == offsetSeconds) {
+    offsetValidUntil = hi * 3600;  // no change within the window, look again then
+    return;
+  }
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (offset(mid * 3600) == offsetSeconds) lo = mid;
+    else hi = mid;
+  }
+  offsetValidUntil = hi * 3600;
+}
+
+bool TimeService::update(uint32_t nowMs) {
+  bool due = !attempted || nowMs - lastSyncAttemptMs >= (synced ? syncIntervalMs : retryIntervalMs);
+  if (due) trySync(nowMs);
+  if (!synced) return false;
+
+  // advance from millis(), the delta arithmetic survives the rollover
+  subSecondMs += nowMs - lastUpdateMs;
+  lastUpdateMs = nowMs;
+  utcSeconds += subSecondMs / 1000;
+  subSecondMs %= 1000;
+
+  if ((int32_t)(utcSeconds - offsetValidUntil) >= 0) refreshOffset();
+
+  uint32_t local = localTime();
+  uint32_t minutes = local / 60;
+  if (minutes == lastMinute) return false;
+  lastMinute = minutes;
+  minuteOfDay = minutes % 1440;
+  weekday = (local / 86400 + 4) % 7;  // 1970-01-01 was a Thursday
+  return true;
+}
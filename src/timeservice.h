@@ -0,0 +1,60 @@
+// timeservice.h
+
+#ifndef TIMESERVICE_H
+#define TIMESERVICE_H
+
+#include <stdint.h>
+
+// Returns the current UTC epoch from NTP, 0 if the sync failed
+typedef uint32_t (*TimeSyncSource)();
+// Returns the local time offset in seconds for a UTC epoch (time zone + DST)
+typedef int32_t (*UtcOffsetSource)(uint32_t utc);
+
+// Local clock advanced from millis() between NTP syncs. The DST offset is kept
+// until the next transition and the calendar fields only change on minute boundaries.
+class TimeService {
+public:
+  TimeService(TimeSyncSource sync, UtcOffsetSource offset, uint32_t syncIntervalMs, uint32_t retryIntervalMs);
+
+  // Call periodically, returns true when a new local minute has started (or after a time jump)
+  bool update(uint32_t nowMs);
+
+  bool isSynced() const { return synced; }
+  uint32_t utc() const { return utcSeconds; }
+  uint32_t localTime() const { return utcSeconds + offsetSeconds; }
+
+  // Calendar fields of the local time, valid after the first sync
+  uint8_t hour() const { return minuteOfDay / 60; }
+  uint8_t minute() const { return minuteOfDay % 60; }
+  uint16_t minuteOfDayValue() const { return minuteOfDay; }
+  uint8_t dayOfWeek() const { return weekday; }  // 0 = Sunday, like NTPClient::getDay()
+
+  uint32_t syncCount = 0;
+  uint32_t syncFailures = 0;
+  uint32_t offsetLookups = 0;
+
+private:
+  void trySync(uint32_t nowMs);
+  void refreshOffset();
+
+  TimeSyncSource sync;
+  UtcOffsetSource offset;
+  uint32_t syncIntervalMs;
+  uint32_t retryIntervalMs;
+
+  bool synced = false;
+  bool attempted = false;
+  uint32_t lastSyncAttemptMs = 0;
+  uint32_t lastUpdateMs = 0;
+  uint32_t subSecondMs = 0;
+  uint32_t utcSeconds = 0;
+
+  int32_t offsetSeconds = 0;
+  uint32_t offsetValidUntil = 0;  // UTC epoch of the next offset change (or next check)
+
+  uint32_t lastMinute = 0xFFFFFFFF;  // local minutes since epoch
+  uint16_t minuteOfDay = 0;
+  uint8_t weekday = 0;
+};
+
+#endif
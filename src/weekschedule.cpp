@@ -0,0 +1,121 @@
+// weekschedule.cpp
+
+#include <string.h>
+#include "weekschedule.h"
+
+bool WeekSchedule::insert(uint16_t minuteOfWeek, int16_t tenths) {
+  // first point after the new one, the arrays stay sorted
+  uint8_t i = count;
+  while (i > 0 && minute[i - 1] > minuteOfWeek) i--;
+  if (i > 0 && minute[i - 1] == minuteOfWeek) {
+    value[i - 1] = tenths;
+    return true;
+  }
+  if (count >= SCHEDULE_MAX_POINTS) return false;
+  memmove(&minute[i + 1], &minute[i], (count - i) * sizeof(minute[0]));
+  memmove(&value[i + 1], &value[i], (count - i) * sizeof(value[0]));
+  minute[i] = minuteOfWeek;
+  value[i] = tenths;
+  count++;
+  return true;
+}
+
+bool WeekSchedule::add(uint8_t day, uint16_t minuteOfDay, float setpoint) {
+  if (day > SCHEDULE_WEEKEND || minuteOfDay >= 1440 || setpoint < 0 || setpoint > 90) return false;
+  int16_t tenths = setpoint * 10 + 0.5;
+  for (uint8_t d = 0; d < 7; d++) {
+    bool match = day == d || day == SCHEDULE_EVERY_DAY || (day == SCHEDULE_WORKDAYS && d >= 1 && d <= 5) ||
+                 (day == SCHEDULE_WEEKEND && (d == 0 || d == 6));
+    if (match && !insert(d * 1440 + minuteOfDay, tenths)) return false;
+  }
+  return true;
+}
+
+int8_t WeekSchedule::indexAt(uint16_t minuteOfWeek) const {
+  if (count == 0) return -1;
+  // last point at or before minuteOfWeek, before the first one the week's last point holds
+  uint8_t lo = 0, hi = count;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    if (minute[mid] <= minuteOfWeek) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo > 0 ? lo - 1 : count - 1;
+}
+
+// Minimal JSON reader for the schedule payload, bounded by the payload length
+struct ScheduleReader {
+  const char* p;
+  const char* end;
+
+  void skipSpace() {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+  }
+  bool expect(char c) {
+    skipSpace();
+    if (p >= end || *p != c) return false;
+    p++;
+    return true;
+  }
+  bool number(float& out) {
+    skipSpace();
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    const char* start = p;
+    float v = 0, scale = 0;
+    for (; p < end && ((*p >= '0' && *p <= '9') || (*p == '.' && scale == 0)); p++) {
+      if (*p == '.') {
+        scale = 1;
+        continue;
+      }
+      v = v * 10 + (*p - '0');
+      if (scale) scale *= 10;
+    }
+    if (p == start) return false;
+    out = (negative ? -v : v) / (scale ? scale : 1);
+    return true;
+  }
+  // "HH:MM"
+  bool time(uint16_t& minuteOfDay) {
+    float hours, minutes;
+    if (!expect('"') || !number(hours) || !expect(':') || !number(minutes) || !expect('"')) return false;
+    if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59) return false;
+    minuteOfDay = (uint16_t)hours * 60 + (uint16_t)minutes;
+    return true;
+  }
+};
+
+static bool parseCircuit(ScheduleReader& r, WeekSchedule& schedule) {
+  if (!r.expect('[')) return false;
+  if (r.expect(']')) return true;
+  do {
+    float day, setpoint;
+    uint16_t minuteOfDay;
+    if (!r.expect('[') || !r.number(day) || !r.expect(',') || !r.time(minuteOfDay) || !r.expect(',') ||
+        !r.number(setpoint) || !r.expect(']')) {
+      return false;
+    }
+    if (day < 0 || !schedule.add((uint8_t)day, minuteOfDay, setpoint)) return false;
+  } while (r.expect(','));
+  return r.expect(']');
+}
+
+bool parseWeekSchedule(const char* json, uint16_t length, WeekSchedule schedules[SCHEDULE_CIRCUITS]) {
+  static const char* const keys[SCHEDULE_CIRCUITS] = { "ch", "dhw" };
+  for (uint8_t c = 0; c < SCHEDULE_CIRCUITS; c++) schedules[c].clear();
+  ScheduleReader r = { json, json + length };
+  if (!r.expect('{')) return false;
+  if (r.expect('}')) return true;
+  do {
+    // "key":
+    if (!r.expect('"')) return false;
+    const char* key = r.p;
+    while (r.p < r.end && *r.p != '"') r.p++;
+    uint16_t keyLength = r.p - key;
+    if (!r.expect('"') || !r.expect(':')) return false;
+    uint8_t c = 0;
+    while (c < SCHEDULE_CIRCUITS && (strlen(keys[c]) != keyLength || strncmp(keys[c], key, keyLength) != 0)) c++;
+    if (c == SCHEDULE_CIRCUITS || !parseCircuit(r, schedules[c])) return false;
+  } while (r.expect(','));
+  return r.expect('}');
+}
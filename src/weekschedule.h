@@ -0,0 +1,52 @@
+// weekschedule.h
+
+#ifndef WEEKSCHEDULE_H
+#define WEEKSCHEDULE_H
+
+#include <stdint.h>
+
+#define SCHEDULE_MINUTES_PER_WEEK 10080
+// Switch points per circuit and week, e.g. 4 a day
+#define SCHEDULE_MAX_POINTS 28
+// Day codes of a switch point besides 0 = Sunday .. 6 = Saturday
+#define SCHEDULE_EVERY_DAY 7
+#define SCHEDULE_WORKDAYS 8
+#define SCHEDULE_WEEKEND 9
+
+// Scheduled circuits: room setpoint of the central heating, DHW tank setpoint
+enum ScheduleCircuit : uint8_t {
+  SCHEDULE_CH,
+  SCHEDULE_DHW,
+  SCHEDULE_CIRCUITS
+};
+
+// Switch points of one circuit over the week. minute[] is kept sorted (minute of the week,
+// 0 = Sunday 00:00), so the point in force is a binary search. A setpoint holds until the next
+// point, the last point of the week carries on into the next one.
+struct WeekSchedule {
+  uint8_t count;
+  uint16_t minute[SCHEDULE_MAX_POINTS];
+  int16_t value[SCHEDULE_MAX_POINTS];  // setpoint in 1/10 K
+
+  void clear() { count = 0; }
+  // Adds a point on one day or a day group, a point at the same minute is replaced.
+  // False when the schedule is full or the point is invalid.
+  bool add(uint8_t day, uint16_t minuteOfDay, float setpoint);
+  // Index of the point in force, -1 for an empty schedule
+  int8_t indexAt(uint16_t minuteOfWeek) const;
+  uint8_t next(uint8_t index) const { return index + 1 < count ? index + 1 : 0; }
+  // Minutes from minuteOfWeek until point index starts, wrapping round the week
+  uint16_t minutesUntil(uint16_t minuteOfWeek, uint8_t index) const {
+    return (minute[index] + SCHEDULE_MINUTES_PER_WEEK - minuteOfWeek) % SCHEDULE_MINUTES_PER_WEEK;
+  }
+  float setpoint(uint8_t index) const { return value[index] / 10.0; }
+
+private:
+  bool insert(uint16_t minuteOfWeek, int16_t tenths);
+};
+
+// Parses {"ch":[[<day>,"HH:MM",<°C>],...],"dhw":[...]} (day codes as above) into one schedule per
+// circuit. A circuit missing from the payload comes back empty. False on a syntax error or overflow.
+bool parseWeekSchedule(const char* json, uint16_t length, WeekSchedule schedules[SCHEDULE_CIRCUITS]);
+
+#endif
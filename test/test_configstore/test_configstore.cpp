@@ -0,0 +1,247 @@
+// test_configstore.cpp
+//
+// Wear-levelled CRC store against a RAM flash: rotation over the sectors, torn and corrupted
+// records, version bumps, shorter blobs of an older firmware and the write debounce
+
+#include <unity.h>
+#include <string.h>
+#include "configstore.h"
+
+#define TEST_SECTORS 4
+#define TEST_SECTOR_BYTES 1024  // 4 slots per sector
+
+// NOR flash in RAM: erase sets 0xFF, writes can only clear bits. powerLossAfter cuts the next
+// write after that many bytes and ignores everything until the next power-up.
+class RamFlash : public Flash {
+public:
+  RamFlash() { memset(bytes, 0xFF, sizeof(bytes)); }
+  uint32_t sectorSize() override { return TEST_SECTOR_BYTES; }
+  uint16_t sectorCount() override { return TEST_SECTORS; }
+  bool read(uint32_t address, void* data, uint32_t length) override {
+    if (address + length > sizeof(bytes)) return false;
+    memcpy(data, bytes + address, length);
+    return true;
+  }
+  bool write(uint32_t address, const void* data, uint32_t length) override {
+    if (address + length > sizeof(bytes)) return false;
+    if (dead) return true;  // the controller is already gone
+    if (powerLossAfter >= 0 && (uint32_t)powerLossAfter < length) {
+      length = powerLossAfter;
+      dead = true;
+    }
+    for (uint32_t i = 0; i < length; i++) bytes[address + i] &= ((const uint8_t*)data)[i];
+    return true;
+  }
+  bool eraseSector(uint16_t sector) override {
+    if (dead) return true;
+    memset(bytes + sector * TEST_SECTOR_BYTES, 0xFF, TEST_SECTOR_BYTES);
+    erases[sector]++;
+    return true;
+  }
+  void powerUp() {
+    dead = false;
+    powerLossAfter = -1;
+  }
+
+  uint8_t bytes[TEST_SECTORS * TEST_SECTOR_BYTES];
+  uint32_t erases[TEST_SECTORS] = { 0 };
+  int32_t powerLossAfter = -1;
+  bool dead = false;
+};
+
+struct Config {
+  float setpoint;
+  uint32_t counter;
+};
+
+struct ConfigV2 {  // same version, one field appended
+  float setpoint;
+  uint32_t counter;
+  float added;
+};
+
+RamFlash* flash;
+
+void setUp() {
+  flash = new RamFlash();
+}
+
+void tearDown() {
+  delete flash;
+}
+
+void test_erased_flash_keeps_the_defaults() {
+  ConfigStore store(1);
+  Config c = { 45.0, 7 };
+  TEST_ASSERT_FALSE(store.load(*flash, &c, sizeof(c)));
+  TEST_ASSERT_EQUAL_FLOAT(45.0, c.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(7, c.counter);
+}
+
+void test_round_trip_through_a_new_store() {
+  ConfigStore store(1);
+  Config c = { 0, 0 };
+  store.load(*flash, &c, sizeof(c));
+  c = { 52.5, 3 };
+  TEST_ASSERT_TRUE(store.save(&c, sizeof(c)));
+
+  ConfigStore reboot(1);
+  Config d = { 0, 0 };
+  TEST_ASSERT_TRUE(reboot.load(*flash, &d, sizeof(d)));
+  TEST_ASSERT_EQUAL_FLOAT(52.5, d.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(3, d.counter);
+  TEST_ASSERT_EQUAL_UINT32(1, reboot.sequence());
+}
+
+void test_writes_rotate_over_all_sectors() {
+  const uint32_t saves = 40;
+  const uint32_t slots = TEST_SECTORS * (TEST_SECTOR_BYTES / CONFIG_SLOT_BYTES);
+  ConfigStore store(1);
+  Config c = { 0, 0 };
+  store.load(*flash, &c, sizeof(c));
+  for (uint32_t i = 1; i <= saves; i++) {
+    c.counter = i;
+    TEST_ASSERT_TRUE(store.save(&c, sizeof(c)));
+    if (i % 7 == 0) {  // reboots in between continue after the newest record
+      ConfigStore reboot(1);
+      Config d;
+      TEST_ASSERT_TRUE(reboot.load(*flash, &d, sizeof(d)));
+      TEST_ASSERT_EQUAL_UINT32(i, d.counter);
+      store = reboot;
+    }
+  }
+  // one erase per pass over a sector, spread evenly
+  for (uint8_t s = 0; s < TEST_SECTORS; s++) {
+    uint32_t expected = (saves + slots - 1 - s * (TEST_SECTOR_BYTES / CONFIG_SLOT_BYTES)) / slots;
+    TEST_ASSERT_EQUAL_UINT32(expected, flash->erases[s]);
+  }
+  ConfigStore reboot(1);
+  Config d;
+  TEST_ASSERT_TRUE(reboot.load(*flash, &d, sizeof(d)));
+  TEST_ASSERT_EQUAL_UINT32(saves, d.counter);
+  TEST_ASSERT_EQUAL_UINT32(saves, reboot.sequence());
+}
+
+void test_torn_write_falls_back_to_the_previous_record() {
+  ConfigStore store(1);
+  Config c = { 0, 0 };
+  store.load(*flash, &c, sizeof(c));
+  c = { 40.0, 1 };
+  store.save(&c, sizeof(c));
+  c = { 60.0, 2 };
+  flash->powerLossAfter = CONFIG_HEADER_BYTES + 2;  // header and half the setpoint
+  store.save(&c, sizeof(c));
+
+  flash->powerUp();
+  ConfigStore reboot(1);
+  Config d = { 0, 0 };
+  TEST_ASSERT_TRUE(reboot.load(*flash, &d, sizeof(d)));
+  TEST_ASSERT_EQUAL_FLOAT(40.0, d.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(1, d.counter);
+  // the next save goes past the torn slot and wins
+  d.counter = 3;
+  TEST_ASSERT_TRUE(reboot.save(&d, sizeof(d)));
+  ConfigStore again(1);
+  Config e;
+  TEST_ASSERT_TRUE(again.load(*flash, &e, sizeof(e)));
+  TEST_ASSERT_EQUAL_UINT32(3, e.counter);
+}
+
+void test_crc_rejects_a_flipped_bit() {
+  ConfigStore store(1);
+  Config c = { 0, 0 };
+  store.load(*flash, &c, sizeof(c));
+  c.counter = 1;
+  store.save(&c, sizeof(c));
+  c.counter = 2;
+  store.save(&c, sizeof(c));
+  flash->bytes[CONFIG_SLOT_BYTES + CONFIG_HEADER_BYTES + 4] ^= 0x01;  // counter of the second record
+
+  ConfigStore reboot(1);
+  Config d;
+  TEST_ASSERT_TRUE(reboot.load(*flash, &d, sizeof(d)));
+  TEST_ASSERT_EQUAL_UINT32(1, d.counter);
+}
+
+void test_other_version_keeps_the_defaults() {
+  ConfigStore v1(1);
+  Config c = { 0, 0 };
+  v1.load(*flash, &c, sizeof(c));
+  c = { 55.0, 9 };
+  v1.save(&c, sizeof(c));
+
+  ConfigStore v2(2);
+  Config d = { 45.0, 0 };
+  v2.load(*flash, &d, sizeof(d));
+  TEST_ASSERT_EQUAL_FLOAT(45.0, d.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(0, d.counter);
+  // the new version continues the sequence and replaces the old record
+  TEST_ASSERT_TRUE(v2.save(&d, sizeof(d)));
+  ConfigStore reboot(2);
+  Config e = { 0, 5 };
+  TEST_ASSERT_TRUE(reboot.load(*flash, &e, sizeof(e)));
+  TEST_ASSERT_EQUAL_FLOAT(45.0, e.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(2, reboot.sequence());
+}
+
+void test_shorter_blob_keeps_the_appended_defaults() {
+  ConfigStore old(1);
+  Config c = { 0, 0 };
+  old.load(*flash, &c, sizeof(c));
+  c = { 48.0, 4 };
+  old.save(&c, sizeof(c));
+
+  ConfigStore updated(1);
+  ConfigV2 d = { 0, 0, 5.0 };
+  TEST_ASSERT_TRUE(updated.load(*flash, &d, sizeof(d)));
+  TEST_ASSERT_EQUAL_FLOAT(48.0, d.setpoint);
+  TEST_ASSERT_EQUAL_UINT32(4, d.counter);
+  TEST_ASSERT_EQUAL_FLOAT(5.0, d.added);
+}
+
+void test_update_debounces_and_skips_unchanged() {
+  ConfigStore store(1);
+  Config c = { 40.0, 0 };
+  store.load(*flash, &c, sizeof(c));
+  TEST_ASSERT_FALSE(store.update(&c, sizeof(c), 0));  // as loaded, nothing to write
+
+  // a slider dragged for 3 s: one write, 5 s after the last change
+  uint32_t t = 1000;
+  for (; t <= 4000; t += 500) {
+    c.setpoint += 0.5;
+    TEST_ASSERT_FALSE(store.update(&c, sizeof(c), t));
+  }
+  TEST_ASSERT_FALSE(store.update(&c, sizeof(c), 4000 + CONFIG_DEBOUNCE_MS - 1));
+  TEST_ASSERT_TRUE(store.update(&c, sizeof(c), 4000 + CONFIG_DEBOUNCE_MS));
+  TEST_ASSERT_EQUAL_UINT32(1, store.writes);
+
+  // changed and changed back before the debounce: no write
+  c.counter = 1;
+  store.update(&c, sizeof(c), 20000);
+  c.counter = 0;
+  store.update(&c, sizeof(c), 21000);
+  TEST_ASSERT_FALSE(store.update(&c, sizeof(c), 30000));
+  TEST_ASSERT_EQUAL_UINT32(1, store.writes);
+
+  // changing all the time is written after the max delay
+  bool written = false;
+  for (t = 40000; t < 40000 + CONFIG_MAX_DELAY_MS + 2000 && !written; t += 1000) {
+    c.counter++;
+    written = store.update(&c, sizeof(c), t);
+  }
+  TEST_ASSERT_TRUE(written);
+  TEST_ASSERT_EQUAL_UINT32(40000 + CONFIG_MAX_DELAY_MS + 1000, t);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_erased_flash_keeps_the_defaults);
+  RUN_TEST(test_round_trip_through_a_new_store);
+  RUN_TEST(test_writes_rotate_over_all_sectors);
+  RUN_TEST(test_torn_write_falls_back_to_the_previous_record);
+  RUN_TEST(test_crc_rejects_a_flipped_bit);
+  RUN_TEST(test_other_version_keeps_the_defaults);
+  RUN_TEST(test_shorter_blob_keeps_the_appended_defaults);
+  RUN_TEST(test_update_debounces_and_skips_unchanged);
+  return UNITY_END();
+}
@@ -0,0 +1,162 @@
+// test_lcdframe.cpp
+//
+// Shadow framebuffer diffing: characters, cursor moves and I2C bytes per flush, run merging
+
+#include <unity.h>
+#include <string.h>
+#include "lcdframe.h"
+
+// Records what a flush sends and what the display would show
+struct RecordingLcd {
+  char screen[LCD_ROWS][LCD_COLS + 1];
+  uint8_t col = 0;
+  uint8_t row = 0;
+  uint16_t moves = 0;
+  uint16_t writes = 0;
+
+  RecordingLcd() {
+    for (uint8_t r = 0; r < LCD_ROWS; r++) {
+      memset(screen[r], '?', LCD_COLS);
+      screen[r][LCD_COLS] = '\0';
+    }
+  }
+  void setCursor(uint8_t c, uint8_t r) {
+    col = c;
+    row = r;
+    moves++;
+  }
+  void write(uint8_t ch) {
+    TEST_ASSERT_TRUE(col < LCD_COLS);  // the controller does not wrap to the next row
+    screen[row][col++] = ch;
+    writes++;
+  }
+};
+
+LcdFrame* frame;
+RecordingLcd* lcd;
+
+void setUp() {
+  frame = new LcdFrame();
+  lcd = new RecordingLcd();
+  frame->flush(*lcd);  // initial full draw
+  lcd->moves = 0;
+  lcd->writes = 0;
+}
+
+void tearDown() {
+  delete frame;
+  delete lcd;
+}
+
+void test_first_flush_draws_every_cell() {
+  LcdFrame f;
+  RecordingLcd l;
+  LcdFlushStats s = f.flush(l);
+  TEST_ASSERT_EQUAL_UINT16(LCD_ROWS * LCD_COLS, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(LCD_ROWS, s.cursorMoves);  // one run per row
+  TEST_ASSERT_EQUAL_UINT16((80 + 4) * LCD_I2C_BYTES_PER_WRITE, s.i2cBytes);
+  for (uint8_t r = 0; r < LCD_ROWS; r++) TEST_ASSERT_EQUAL_STRING("                    ", l.screen[r]);
+}
+
+void test_unchanged_frame_sends_nothing() {
+  LcdFlushStats s = frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_UINT16(0, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(0, s.cursorMoves);
+  TEST_ASSERT_EQUAL_UINT16(0, s.i2cBytes);
+  TEST_ASSERT_EQUAL_UINT16(0, lcd->moves + lcd->writes);
+}
+
+void test_one_clean_cell_is_rewritten_instead_of_a_cursor_move() {
+  frame->print(2, 1, "a");
+  frame->print(4, 1, "b");
+  LcdFlushStats s = frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_UINT16(3, s.chars);  // a, the clean space in between, b
+  TEST_ASSERT_EQUAL_UINT16(1, s.cursorMoves);
+  TEST_ASSERT_EQUAL_UINT16(4 * LCD_I2C_BYTES_PER_WRITE, s.i2cBytes);
+  TEST_ASSERT_EQUAL_STRING("  a b               ", lcd->screen[1]);
+}
+
+void test_two_clean_cells_split_the_run() {
+  frame->print(2, 1, "a");
+  frame->print(5, 1, "b");
+  LcdFlushStats s = frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_UINT16(2, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(2, s.cursorMoves);
+  TEST_ASSERT_EQUAL_UINT16(4 * LCD_I2C_BYTES_PER_WRITE, s.i2cBytes);
+  TEST_ASSERT_EQUAL_STRING("  a  b              ", lcd->screen[1]);
+}
+
+void test_runs_in_several_rows_and_at_the_row_end() {
+  frame->print(0, 0, "12.5", 4);
+  frame->print(19, 2, "x");
+  frame->print(16, 3, "ab");
+  frame->print(19, 3, "c");
+  LcdFlushStats s = frame->flush(*lcd);
+  // row 0: 4 chars, row 2: 1 char, row 3: "ab c" merged over one clean cell
+  TEST_ASSERT_EQUAL_UINT16(4 + 1 + 4, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(3, s.cursorMoves);
+  TEST_ASSERT_EQUAL_UINT16((9 + 3) * LCD_I2C_BYTES_PER_WRITE, s.i2cBytes);
+  TEST_ASSERT_EQUAL_STRING("12.5                ", lcd->screen[0]);
+  TEST_ASSERT_EQUAL_STRING("                   x", lcd->screen[2]);
+  TEST_ASSERT_EQUAL_STRING("                ab c", lcd->screen[3]);
+}
+
+void test_redrawing_the_same_text_is_free() {
+  frame->print(0, 1, "FlameOn ", 8);
+  frame->flush(*lcd);
+  frame->print(0, 1, "FlameOn ", 8);
+  TEST_ASSERT_EQUAL_UINT16(0, frame->flush(*lcd).chars);
+  frame->print(0, 1, "FlameOff", 8);  // only the last two cells differ
+  LcdFlushStats s = frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_UINT16(2, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(1, s.cursorMoves);
+  TEST_ASSERT_EQUAL_STRING("FlameOff            ", lcd->screen[1]);
+}
+
+void test_width_padding_and_number_overflow() {
+  frame->print(0, 0, "long text", 4);
+  frame->printNumber(5, 0, 123.0, 2);
+  frame->printNumber(8, 0, 7.0, 3);
+  frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_STRING("long ** 7           ", lcd->screen[0]);
+}
+
+void test_invalidate_redraws_and_totals_add_up() {
+  uint32_t before = frame->totalI2cBytes();
+  frame->invalidate();
+  LcdFlushStats s = frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_UINT16(80, s.chars);
+  TEST_ASSERT_EQUAL_UINT16(4, s.cursorMoves);
+  TEST_ASSERT_EQUAL_UINT32(before + s.i2cBytes, frame->totalI2cBytes());
+  TEST_ASSERT_EQUAL_UINT16(s.i2cBytes, frame->lastFlush().i2cBytes);
+}
+
+void test_boiler_state_keeps_all_digits_of_the_fault_code() {
+  char text[LCD_STATE_WIDTH + 1];
+  formatBoilerState(text, sizeof(text), true, false, 0);
+  TEST_ASSERT_EQUAL_STRING("FlameOn ", text);
+  formatBoilerState(text, sizeof(text), false, false, 0);
+  TEST_ASSERT_EQUAL_STRING("noFlame ", text);
+  formatBoilerState(text, sizeof(text), true, true, 7);
+  TEST_ASSERT_EQUAL_STRING("Err 7", text);
+  TEST_ASSERT_EQUAL_UINT8(7, formatBoilerState(text, sizeof(text), false, true, 123));
+  TEST_ASSERT_EQUAL_STRING("Err 123", text);
+  formatBoilerState(text, sizeof(text), false, true, 255);
+  frame->print(0, 1, text, LCD_STATE_WIDTH);
+  frame->flush(*lcd);
+  TEST_ASSERT_EQUAL_STRING("Err 255             ", lcd->screen[1]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_flush_draws_every_cell);
+  RUN_TEST(test_unchanged_frame_sends_nothing);
+  RUN_TEST(test_one_clean_cell_is_rewritten_instead_of_a_cursor_move);
+  RUN_TEST(test_two_clean_cells_split_the_run);
+  RUN_TEST(test_runs_in_several_rows_and_at_the_row_end);
+  RUN_TEST(test_redrawing_the_same_text_is_free);
+  RUN_TEST(test_width_padding_and_number_overflow);
+  RUN_TEST(test_invalidate_redraws_and_totals_add_up);
+  RUN_TEST(test_boiler_state_keeps_all_digits_of_the_fault_code);
+  return UNITY_END();
+}
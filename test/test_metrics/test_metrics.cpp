@@ -0,0 +1,172 @@
+// test_metrics.cpp
+//
+// Metrics report: every buffer size from nothing to the full report gives valid JSON, and the
+// gateway counters appear in the "ot" object in gateway mode
+
+#include <unity.h>
+#include <string.h>
+#include "metrics.h"
+#include "scheduler.h"
+#include "otpoll.h"
+#include "otqueue.h"
+#include "otgateway.h"
+
+class NullThermostat : public OtSlavePort {
+public:
+  bool sendResponse(uint32_t) override { return true; }
+  void process() override {}
+};
+
+uint32_t fakeNow = 0;
+
+uint32_t fakeMillis() {
+  return fakeNow;
+}
+
+void job() {
+  fakeNow += 3;
+}
+
+PollEntry table[] = {
+  { 0, 0, 3, 1000, 0, nullptr },
+  { 25, 0, 2, 10000, 0, nullptr },
+  { 116, 0, 1, 600000, 0, nullptr },
+};
+
+Scheduler* scheduler;
+OtPollScheduler* poll;
+OtFrameQueue queue;
+OtGateway gateway;
+NullThermostat thermostat;
+SystemMetrics sys = { 86400, 31000, 24000, -67 };
+
+void setUp() {
+  fakeNow = 0;
+  scheduler = new Scheduler(fakeMillis);
+  scheduler->addTask("otProcess", job, 0, 5);
+  scheduler->addTask("heating", job, 1000, 50);
+  scheduler->addTask("mqtt", job, 100, 20);
+  for (int i = 0; i < 50; i++) {
+    scheduler->run();
+    fakeNow += 100;
+  }
+  poll = new OtPollScheduler(table, 3);
+  table[1].successes = 4021;
+  table[1].timeouts = 3;
+  gateway = OtGateway();
+}
+
+void tearDown() {
+  delete poll;
+  delete scheduler;
+}
+
+// Just enough of a JSON parser for the report: objects, arrays, strings and integers
+const char* value(const char* p);
+
+const char* members(const char* p, char end, bool keys) {
+  if (*p == end) return p + 1;
+  while (true) {
+    if (keys) {
+      if (*p != '"') return nullptr;
+      p = value(p);
+      if (!p || *p != ':') return nullptr;
+      p++;
+    }
+    p = value(p);
+    if (!p) return nullptr;
+    if (*p == end) return p + 1;
+    if (*p != ',') return nullptr;
+    p++;
+  }
+}
+
+const char* value(const char* p) {
+  if (*p == '{') return members(p + 1, '}', true);
+  if (*p == '[') return members(p + 1, ']', false);
+  if (*p == '"') {
+    p++;
+    while (*p && *p != '"') p++;
+    return *p ? p + 1 : nullptr;
+  }
+  const char* start = p;
+  if (*p == '-') p++;
+  while (*p >= '0' && *p <= '9') p++;
+  return p > start ? p : nullptr;
+}
+
+bool validJson(const char* s) {
+  const char* end = value(s);
+  return end && *end == '\0';
+}
+
+void test_full_report_is_valid() {
+  char out[1024];
+  uint16_t len = formatMetrics(out, sizeof(out), sys, *scheduler, *poll, queue, gateway);
+  TEST_ASSERT_EQUAL_UINT32(strlen(out), len);
+  TEST_ASSERT_TRUE(validJson(out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"heating\":["));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"25\":[4021,3,0],\"116\":[0,0,0]}}"));
+  TEST_ASSERT_NULL(strstr(out, "gateway"));
+}
+
+void test_every_short_buffer_gives_valid_json() {
+  char full[1024];
+  uint16_t fullLen = formatMetrics(full, sizeof(full), sys, *scheduler, *poll, queue, gateway);
+  for (uint16_t size = 3; size <= fullLen + 1; size++) {
+    char out[1024];
+    memset(out, 'x', sizeof(out));
+    uint16_t len = formatMetrics(out, size, sys, *scheduler, *poll, queue, gateway);
+    TEST_ASSERT_TRUE(len < size);
+    TEST_ASSERT_EQUAL_UINT32(strlen(out), len);
+    TEST_ASSERT_EQUAL_UINT8('x', (uint8_t)out[size]);  // nothing written past the buffer
+    if (!validJson(out)) {
+      TEST_FAIL_MESSAGE(out);
+    }
+  }
+  char out[8];
+  TEST_ASSERT_EQUAL_UINT32(0, formatMetrics(out, 1, sys, *scheduler, *poll, queue, gateway));
+  TEST_ASSERT_EQUAL_STRING("", out);
+}
+
+void test_counters_past_2_31_stay_positive() {
+  SystemMetrics big = { 3000000000UL, 3000000000UL, 2147483648UL, -67 };
+  table[0].successes = 4294967295UL;
+  queue.pushed = 3000000000UL;
+  char out[1024];
+  formatMetrics(out, sizeof(out), big, *scheduler, *poll, queue, gateway);
+  queue.pushed = 0;
+  table[0].successes = 0;
+  TEST_ASSERT_TRUE(validJson(out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "{\"up\":3000000000,\"heap\":3000000000,\"heapMin\":2147483648,\"rssi\":-67,"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"queue\":[3000000000,"));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"0\":[4294967295,"));
+}
+
+void test_gateway_counters_in_the_ot_object() {
+  OtBus* boiler = nullptr;
+  gateway.begin(&thermostat, boiler, nullptr);
+  gateway.forwarded = 120;
+  gateway.overrides = 7;
+  gateway.answered = 118;
+  gateway.unanswered = 2;
+  gateway.late = 1;
+  gateway.invalid = 4;
+  char out[1024];
+  formatMetrics(out, sizeof(out), sys, *scheduler, *poll, queue, gateway);
+  TEST_ASSERT_TRUE(validJson(out));
+  TEST_ASSERT_NOT_NULL(strstr(out, "\"gateway\":{\"forwarded\":120,\"overrides\":7,\"answered\":118,"
+                                   "\"unanswered\":2,\"late\":1,\"invalid\":4}"));
+  const char* ot = strstr(out, "\"ot\":{");
+  TEST_ASSERT_NOT_NULL(ot);
+  TEST_ASSERT_TRUE(strstr(out, "\"gateway\"") > ot);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_report_is_valid);
+  RUN_TEST(test_every_short_buffer_gives_valid_json);
+  RUN_TEST(test_counters_past_2_31_stay_positive);
+  RUN_TEST(test_gateway_counters_in_the_ot_object);
+  return UNITY_END();
+}
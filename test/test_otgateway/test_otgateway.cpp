@@ -0,0 +1,132 @@
+// test_otgateway.cpp
+//
+// Gateway timing: a request is only forwarded while its answer can still reach the thermostat
+// in its 800 ms window, an answer past the window is not sent
+
+#include <unity.h>
+#include "otgateway.h"
+
+class RecordingBus : public OtBus {
+public:
+  bool isReady() override { return ready; }
+  bool sendRequestAsync(uint32_t request) override {
+    if (!ready) return false;
+    sent = request;
+    requests++;
+    return true;
+  }
+  void process() override {}
+
+  bool ready = true;
+  uint32_t sent = 0;
+  uint32_t requests = 0;
+};
+
+class RecordingThermostat : public OtSlavePort {
+public:
+  bool sendResponse(uint32_t response) override {
+    last = response;
+    responses++;
+    return true;
+  }
+  void process() override {}
+
+  uint32_t last = 0;
+  uint32_t responses = 0;
+};
+
+RecordingBus* bus;
+RecordingThermostat* thermostat;
+OtGateway* gateway;
+
+uint32_t overrideTSet(uint32_t request) {
+  if (otMessageType(request) == OT_WRITE_DATA && otDataId(request) == OtId::TSet) {
+    return otBuildFrame(OT_WRITE_DATA, OtId::TSet, otTemperatureToData(55));
+  }
+  return request;
+}
+
+void setUp() {
+  bus = new RecordingBus();
+  thermostat = new RecordingThermostat();
+  gateway = new OtGateway();
+  gateway->begin(thermostat, bus, overrideTSet);
+}
+
+void tearDown() {
+  delete gateway;
+  delete thermostat;
+  delete bus;
+}
+
+void test_forwards_and_answers_within_the_window() {
+  uint32_t request = otBuildFrame(OT_READ_DATA, OtId::Tboiler, 0);
+  thermostat->frames.push(request, OT_SUCCESS, 1000);
+  gateway->forward(1050);
+  TEST_ASSERT_EQUAL_HEX32(request, bus->sent);
+  uint32_t response = otBuildFrame(OT_READ_ACK, OtId::Tboiler, otTemperatureToData(48));
+  TEST_ASSERT_TRUE(gateway->onBoilerResponse(response, OT_SUCCESS, 1000 + OT_GATEWAY_RESPONSE_WINDOW_MS - 1));
+  TEST_ASSERT_EQUAL_HEX32(response, thermostat->last);
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->answered);
+  TEST_ASSERT_EQUAL_UINT32(0, gateway->late);
+}
+
+void test_drops_a_request_that_waited_too_long() {
+  thermostat->frames.push(otBuildFrame(OT_READ_DATA, OtId::Tboiler, 0), OT_SUCCESS, 1000);
+  thermostat->frames.push(otBuildFrame(OT_READ_DATA, OtId::Tret, 0), OT_SUCCESS, 1100);
+  bus->ready = false;
+  gateway->forward(1150);
+  TEST_ASSERT_EQUAL_UINT32(0, bus->requests);
+  bus->ready = true;
+  // the first one waited 300 ms, its answer could not make it back in time
+  gateway->forward(1000 + OT_GATEWAY_MAX_WAIT_MS + 100);
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->late);
+  TEST_ASSERT_EQUAL_UINT32(1, bus->requests);
+  TEST_ASSERT_EQUAL_UINT8(OtId::Tret, otDataId(bus->sent));
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->forwarded);
+}
+
+void test_answer_past_the_window_is_not_sent() {
+  thermostat->frames.push(otBuildFrame(OT_READ_DATA, OtId::Tboiler, 0), OT_SUCCESS, 1000);
+  gateway->forward(1100);
+  uint32_t response = otBuildFrame(OT_READ_ACK, OtId::Tboiler, otTemperatureToData(48));
+  TEST_ASSERT_TRUE(gateway->onBoilerResponse(response, OT_SUCCESS, 1000 + OT_GATEWAY_RESPONSE_WINDOW_MS));
+  TEST_ASSERT_EQUAL_UINT32(0, thermostat->responses);
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->late);
+  TEST_ASSERT_EQUAL_UINT32(0, gateway->answered);
+  // the gateway is free for the next request
+  thermostat->frames.push(otBuildFrame(OT_READ_DATA, OtId::Tret, 0), OT_SUCCESS, 2000);
+  gateway->forward(2010);
+  TEST_ASSERT_EQUAL_UINT8(OtId::Tret, otDataId(bus->sent));
+}
+
+void test_overridden_write_is_acknowledged_with_the_thermostat_value() {
+  uint32_t request = otBuildFrame(OT_WRITE_DATA, OtId::TSet, otTemperatureToData(40));
+  thermostat->frames.push(request, OT_SUCCESS, 1000);
+  gateway->forward(1010);
+  TEST_ASSERT_EQUAL_UINT16(otTemperatureToData(55), otData(bus->sent));
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->overrides);
+  gateway->onBoilerResponse(otBuildFrame(OT_WRITE_ACK, OtId::TSet, otData(bus->sent)), OT_SUCCESS, 1200);
+  TEST_ASSERT_EQUAL_UINT16(otTemperatureToData(40), otData(thermostat->last));
+}
+
+void test_invalid_frames_and_boiler_timeouts_are_counted() {
+  thermostat->frames.push(0x12345678, OT_INVALID, 1000);
+  thermostat->frames.push(otBuildFrame(OT_READ_DATA, OtId::Tboiler, 0), OT_SUCCESS, 1000);
+  gateway->forward(1010);
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->invalid);
+  TEST_ASSERT_TRUE(gateway->onBoilerResponse(0, OT_TIMEOUT, 1500));
+  TEST_ASSERT_EQUAL_UINT32(1, gateway->unanswered);
+  TEST_ASSERT_EQUAL_UINT32(0, thermostat->responses);
+  TEST_ASSERT_FALSE(gateway->onBoilerResponse(0, OT_SUCCESS, 1600));  // nothing in flight
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_forwards_and_answers_within_the_window);
+  RUN_TEST(test_drops_a_request_that_waited_too_long);
+  RUN_TEST(test_answer_past_the_window_is_not_sent);
+  RUN_TEST(test_overridden_write_is_acknowledged_with_the_thermostat_value);
+  RUN_TEST(test_invalid_frames_and_boiler_timeouts_are_counted);
+  return UNITY_END();
+}
@@ -0,0 +1,104 @@
+// test_otqueue.cpp
+//
+// Frame queue: FIFO order, the full ring and its counters, and a producer and a consumer
+// thread flooding the ring with 2M frames
+
+#include <unity.h>
+#include <thread>
+#include "otqueue.h"
+
+#define FLOOD_FRAMES 2000000UL
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_fifo_order_and_wraparound() {
+  OtFrameQueue q;
+  OtFrame f;
+  TEST_ASSERT_FALSE(q.pop(f));
+  for (uint32_t i = 0; i < 5 * OT_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(q.push(0x40000000 | i, OT_SUCCESS, 1000 + i));
+    TEST_ASSERT_TRUE(q.push(0x40010000 | i, OT_TIMEOUT, 2000 + i));
+    TEST_ASSERT_EQUAL_UINT8(2, q.size());
+    TEST_ASSERT_TRUE(q.pop(f));
+    TEST_ASSERT_EQUAL_HEX32(0x40000000 | i, f.frame);
+    TEST_ASSERT_EQUAL_UINT32(1000 + i, f.ms);
+    TEST_ASSERT_EQUAL_INT(OT_SUCCESS, f.status);
+    TEST_ASSERT_TRUE(q.pop(f));
+    TEST_ASSERT_EQUAL_HEX32(0x40010000 | i, f.frame);
+    TEST_ASSERT_EQUAL_INT(OT_TIMEOUT, f.status);
+  }
+  TEST_ASSERT_EQUAL_UINT32(10 * OT_QUEUE_SIZE, q.pushed);
+  TEST_ASSERT_EQUAL_UINT32(0, q.dropped);
+  TEST_ASSERT_EQUAL_UINT8(2, q.highWater);
+}
+
+void test_full_ring_drops_and_counts() {
+  OtFrameQueue q;
+  for (uint32_t i = 0; i < OT_QUEUE_SIZE - 1; i++) TEST_ASSERT_TRUE(q.push(i, OT_SUCCESS, i));
+  TEST_ASSERT_FALSE(q.push(99, OT_SUCCESS, 99));  // one slot stays empty
+  TEST_ASSERT_EQUAL_UINT32(1, q.dropped);
+  TEST_ASSERT_EQUAL_UINT8(OT_QUEUE_SIZE - 1, q.highWater);
+  OtFrame f;
+  TEST_ASSERT_TRUE(q.pop(f));
+  TEST_ASSERT_EQUAL_UINT32(0, f.frame);
+  TEST_ASSERT_TRUE(q.push(100, OT_SUCCESS, 100));
+  uint32_t last = 0;
+  while (q.pop(f)) last = f.frame;
+  TEST_ASSERT_EQUAL_UINT32(100, last);  // the dropped frame is gone, not overwritten
+}
+
+// The producer pushes a counter, the consumer checks every frame it gets is newer than the
+// previous one and arrived whole (frame, time and status written together). Every frame is
+// either received or counted as dropped.
+void test_two_thread_flood() {
+  static OtFrameQueue q;
+  std::atomic<bool> done{ false };
+  uint32_t received = 0;
+  uint32_t outOfOrder = 0;
+  uint32_t torn = 0;
+
+  std::thread consumer([&]() {
+    OtFrame f;
+    int64_t previous = -1;
+    while (true) {
+      bool finished = done.load(std::memory_order_acquire);
+      bool any = false;
+      while (q.pop(f)) {
+        any = true;
+        received++;
+        if ((int64_t)f.frame <= previous) outOfOrder++;
+        if (f.ms != ~f.frame || f.status != (f.frame & 1 ? OT_INVALID : OT_SUCCESS)) torn++;
+        previous = f.frame;
+      }
+      if (finished && !any) break;
+      if (!any) std::this_thread::yield();
+    }
+  });
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < FLOOD_FRAMES; i++) {
+      q.push(i, i & 1 ? OT_INVALID : OT_SUCCESS, ~i);
+      if ((i & 0xFF) == 0) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+  });
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(FLOOD_FRAMES, q.pushed + q.dropped);
+  TEST_ASSERT_EQUAL_UINT32(q.pushed, received);
+  TEST_ASSERT_TRUE(q.pushed > 0);
+  TEST_ASSERT_TRUE(q.highWater <= OT_QUEUE_SIZE - 1);
+  TEST_ASSERT_EQUAL_UINT8(0, q.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order_and_wraparound);
+  RUN_TEST(test_full_ring_drops_and_counts);
+  RUN_TEST(test_two_thread_flood);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+// test_outbox.cpp
+//
+// Outbox while the broker is unreachable: what the offline filters queue, overflow, and the
+// order and ages the entries are replayed in after the reconnect
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "outbox.h"
+#include "hapublish.h"
+
+// Collects the published messages
+class RecordingLink : public MqttLink {
+public:
+  bool isNetworkConnected() override { return connected; }
+  int16_t rssi() override { return -60; }
+  void localIp(uint8_t ip[4]) override { memset(ip, 0, 4); }
+  bool isConnected() override { return connected; }
+  bool beginPublish(const char* topic, uint16_t length, bool retained) override {
+    if (refuse) return false;
+    current.clear();
+    return true;
+  }
+  void writePayload(const uint8_t* data, uint16_t length) override { current.append((const char*)data, length); }
+  bool endPublish() override {
+    messages.push_back(current);
+    return true;
+  }
+  bool subscribe(const char* topic) override { return true; }
+
+  bool connected = false;
+  bool refuse = false;
+  std::string current;
+  std::vector<std::string> messages;
+};
+
+const char* const keys[] = { "a", "b" };
+MqttOutbox* outbox;
+RecordingLink* link;
+
+void setUp() {
+  outbox = new MqttOutbox();
+  link = new RecordingLink();
+}
+
+void tearDown() {
+  delete outbox;
+  delete link;
+}
+
+// Offline a value that does not move is queued once, not once per heartbeat
+void test_offline_filter_has_no_heartbeat() {
+  SensorPublishFilter filter(0.5, 300000);
+  uint32_t queued = 0;
+  for (uint32_t t = 0; t < 4 * 3600000UL; t += 1000) {
+    if (filter.changed(20.0, t)) queued++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, queued);
+  TEST_ASSERT_FALSE(filter.changed(20.4, 4 * 3600000UL));
+  TEST_ASSERT_TRUE(filter.changed(20.6, 4 * 3600000UL));
+  // online the heartbeat still applies
+  TEST_ASSERT_TRUE(filter.update(20.6, 4 * 3600000UL + 300000));
+}
+
+void test_overflow_drops_the_oldest() {
+  for (uint16_t i = 0; i < OUTBOX_CAPACITY + 10; i++) outbox->push(0, i, i * 1000UL);
+  TEST_ASSERT_EQUAL_UINT16(OUTBOX_CAPACITY, outbox->size());
+  TEST_ASSERT_EQUAL_UINT32(10, outbox->dropped);
+  TEST_ASSERT_EQUAL_UINT16(OUTBOX_CAPACITY, outbox->highWater);
+
+  uint32_t now = (OUTBOX_CAPACITY + 10) * 1000UL;
+  link->connected = true;
+  outbox->flush(*link, "t", keys, now, 0);  // sees the connect, waits for the delay
+  now += OUTBOX_RECONNECT_DELAY_MS;
+  outbox->flush(*link, "t", keys, now, 0);
+  TEST_ASSERT_EQUAL_UINT32(1, link->messages.size());
+  // the first entry left is value 10, queued 10 s after the start
+  char first[32];
+  snprintf(first, sizeof(first), "[%u,\"a\",10.00]", (unsigned)((now - 10000) / 1000));
+  TEST_ASSERT_TRUE(link->messages[0].find(first) != std::string::npos);
+}
+
+void test_replays_oldest_first_in_batches_after_the_delay() {
+  const uint16_t n = 40;
+  for (uint16_t i = 0; i < n; i++) outbox->push(i % 2, i, 1000UL * i);
+  uint32_t now = 100000;
+  TEST_ASSERT_EQUAL_UINT8(0, outbox->flush(*link, "t", keys, now, 0));  // still offline
+  link->connected = true;
+  TEST_ASSERT_EQUAL_UINT8(0, outbox->flush(*link, "t", keys, now, 1700000000));
+  TEST_ASSERT_EQUAL_UINT8(0, outbox->flush(*link, "t", keys, now + OUTBOX_RECONNECT_DELAY_MS - 1, 1700000000));
+
+  now += OUTBOX_RECONNECT_DELAY_MS;
+  uint16_t sent = 0;
+  while (outbox->size() > 0) {
+    uint8_t batch = outbox->flush(*link, "t", keys, now, 1700000000);
+    TEST_ASSERT_TRUE(batch > 0 && batch <= OUTBOX_BATCH);
+    sent += batch;
+  }
+  TEST_ASSERT_EQUAL_UINT16(n, sent);
+  TEST_ASSERT_EQUAL_UINT32(n, outbox->sent);
+  TEST_ASSERT_EQUAL_UINT32(link->messages.size(), outbox->batches);
+
+  // every entry exactly once, in the order it was queued, with its age in seconds
+  std::string all;
+  for (const std::string& m : link->messages) {
+    TEST_ASSERT_EQUAL_UINT32(0, m.find("{\"utc\":1700000000,\"v\":["));
+    TEST_ASSERT_TRUE(m.size() < OUTBOX_BATCH_BYTES);
+    TEST_ASSERT_EQUAL_STRING("]}", m.c_str() + m.size() - 2);
+    all += m;
+  }
+  size_t pos = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    char entry[32];
+    snprintf(entry, sizeof(entry), "[%u,\"%s\",%u.00]", (unsigned)((now - 1000UL * i) / 1000), keys[i % 2], i);
+    size_t at = all.find(entry, pos);
+    TEST_ASSERT_TRUE(at != std::string::npos);
+    pos = at + strlen(entry);
+  }
+}
+
+void test_failed_publish_keeps_the_entries() {
+  outbox->push(0, 1.0, 0);
+  link->connected = true;
+  outbox->flush(*link, "t", keys, 0, 0);
+  link->refuse = true;
+  TEST_ASSERT_EQUAL_UINT8(0, outbox->flush(*link, "t", keys, OUTBOX_RECONNECT_DELAY_MS, 0));
+  TEST_ASSERT_EQUAL_UINT16(1, outbox->size());
+  link->refuse = false;
+  TEST_ASSERT_EQUAL_UINT8(1, outbox->flush(*link, "t", keys, OUTBOX_RECONNECT_DELAY_MS, 0));
+  TEST_ASSERT_EQUAL_UINT16(0, outbox->size());
+}
+
+void test_a_new_outage_restarts_the_delay() {
+  outbox->push(0, 1.0, 0);
+  link->connected = true;
+  outbox->flush(*link, "t", keys, 0, 0);
+  link->connected = false;
+  outbox->flush(*link, "t", keys, 1000, 0);
+  link->connected = true;
+  TEST_ASSERT_EQUAL_UINT8(0, outbox->flush(*link, "t", keys, 2500, 0));
+  TEST_ASSERT_EQUAL_UINT8(1, outbox->flush(*link, "t", keys, 2500 + OUTBOX_RECONNECT_DELAY_MS, 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_offline_filter_has_no_heartbeat);
+  RUN_TEST(test_overflow_drops_the_oldest);
+  RUN_TEST(test_replays_oldest_first_in_batches_after_the_delay);
+  RUN_TEST(test_failed_publish_keeps_the_entries);
+  RUN_TEST(test_a_new_outage_restarts_the_delay);
+  return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// test_scheduler.cpp
+//
+// Scheduler against a fake millis(): due times, jitter, overrun and skipped counters, wraparound
+
+#include <unity.h>
+#include "scheduler.h"
+
+uint32_t fakeNow = 0;
+uint32_t runDurationMs = 0;  // a run advances the clock by this much
+uint32_t calls = 0;
+
+uint32_t fakeMillis() {
+  return fakeNow;
+}
+
+void job() {
+  calls++;
+  fakeNow += runDurationMs;
+}
+
+void setUp() {
+  fakeNow = 0;
+  runDurationMs = 0;
+  calls = 0;
+}
+
+void tearDown() {}
+
+void test_runs_when_due_and_keeps_the_phase() {
+  Scheduler s(fakeMillis);
+  TEST_ASSERT_EQUAL_INT(0, s.addTask("job", job, 100, 20));
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(1, calls);
+  fakeNow = 99;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(1, calls);
+  fakeNow = 105;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  TEST_ASSERT_EQUAL_UINT32(5, s.task(0).lastJitterMs);
+  TEST_ASSERT_EQUAL_UINT32(200, s.task(0).nextRun);  // fixed rate, not 205
+  fakeNow = 200;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(3, calls);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).lastJitterMs);
+  TEST_ASSERT_EQUAL_UINT32(5, s.task(0).maxJitterMs);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).overruns);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).skipped);
+}
+
+void test_counts_overruns_past_the_deadline() {
+  Scheduler s(fakeMillis);
+  s.addTask("job", job, 100, 20);
+  runDurationMs = 20;  // finishes exactly at the deadline
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).overruns);
+  fakeNow = 100;
+  runDurationMs = 21;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(1, s.task(0).overruns);
+  TEST_ASSERT_EQUAL_UINT32(21, s.task(0).lastDurationMs);
+  TEST_ASSERT_EQUAL_UINT32(21, s.task(0).maxDurationMs);
+  // late start with a short run is an overrun too, the deadline counts from the due time
+  fakeNow = 215;
+  runDurationMs = 10;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, s.task(0).overruns);
+}
+
+void test_skips_missed_periods_instead_of_catching_up() {
+  Scheduler s(fakeMillis);
+  s.addTask("job", job, 100, 500);
+  s.run();
+  fakeNow = 350;  // due at 100, 200 and 300 were missed
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  TEST_ASSERT_EQUAL_UINT32(250, s.task(0).lastJitterMs);
+  TEST_ASSERT_EQUAL_UINT32(2, s.task(0).skipped);
+  TEST_ASSERT_EQUAL_UINT32(450, s.task(0).nextRun);
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+}
+
+void test_handles_the_millis_wraparound() {
+  fakeNow = 0xFFFFFF00UL;
+  Scheduler s(fakeMillis);
+  s.addTask("job", job, 100, 20);
+  s.run();
+  fakeNow = 0xFFFFFF64UL;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  TEST_ASSERT_EQUAL_HEX32(0xFFFFFFC8UL, s.task(0).nextRun);
+  fakeNow = 0xFFFFFFC8UL;
+  s.run();
+  TEST_ASSERT_EQUAL_HEX32(0x2C, s.task(0).nextRun);  // wrapped
+  fakeNow = 0x10;  // after the wrap but before the due time
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(3, calls);
+  fakeNow = 0x30;
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(4, calls);
+  TEST_ASSERT_EQUAL_UINT32(4, s.task(0).lastJitterMs);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).skipped);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).overruns);
+}
+
+void test_every_pass_tasks_and_enable() {
+  Scheduler s(fakeMillis);
+  s.addTask("poll", job, 0, 5);
+  s.run();
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(0).lastJitterMs);
+  s.setEnabled(0, false);
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  fakeNow = 50;
+  s.setEnabled(0, true);
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(3, calls);
+  TEST_ASSERT_EQUAL_UINT32(4, s.passes());
+}
+
+void test_find_and_run_at() {
+  Scheduler s(fakeMillis);
+  s.addTask("a", job, 1000, 20);
+  s.addTask("b", job, 1000, 20);
+  TEST_ASSERT_EQUAL_INT(1, s.find("b"));
+  TEST_ASSERT_EQUAL_INT(-1, s.find("c"));
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(2, calls);
+  fakeNow = 10;
+  s.runAt(s.find("b"), fakeNow);
+  s.run();
+  TEST_ASSERT_EQUAL_UINT32(3, calls);
+  TEST_ASSERT_EQUAL_UINT32(0, s.task(1).lastJitterMs);
+  s.runAt(-1, 0);  // ignored
+}
+
+void test_table_full() {
+  Scheduler s(fakeMillis);
+  for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++) TEST_ASSERT_EQUAL_INT(i, s.addTask("t", job, 10, 5));
+  TEST_ASSERT_EQUAL_INT(-1, s.addTask("t", job, 10, 5));
+  TEST_ASSERT_EQUAL_INT(-1, Scheduler(fakeMillis).addTask("t", nullptr, 10, 5));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_when_due_and_keeps_the_phase);
+  RUN_TEST(test_counts_overruns_past_the_deadline);
+  RUN_TEST(test_skips_missed_periods_instead_of_catching_up);
+  RUN_TEST(test_handles_the_millis_wraparound);
+  RUN_TEST(test_every_pass_tasks_and_enable);
+  RUN_TEST(test_find_and_run_at);
+  RUN_TEST(test_table_full);
+  return UNITY_END();
+}